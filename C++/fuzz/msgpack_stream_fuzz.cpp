@@ -0,0 +1,98 @@
+// libFuzzer harness for StreamingDecoder: the input is fed in chunks whose
+// size comes from its first byte, unconsumed bytes are passed again in front
+// of the next chunk as a network reader would. The outcome must not depend on
+// the chunking, accepted input must pass validate() and be walked by the pull
+// decoder. validate() checks structure only, so the reverse does not hold:
+// malformed timestamps are rejected by the decoders alone.
+//
+// Build: clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -I.. msgpack_stream_fuzz.cpp
+// Usage: ./a.out -max_len=65536 corpus/
+
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "msgpack.h"
+
+namespace {
+
+constexpr size_t MAX_ALLOC = 1 << 20;
+
+void check(bool cond) {
+    if(!cond)
+        std::abort();
+}
+
+struct Visitor: msgpack::BasicVisitor<std::string> {
+    bool visit_str(std::string_view arg) { return this->touch(arg.data(), arg.size()); }
+    bool visit_bin(BinType arg) { return this->touch(arg.data(), arg.size()); }
+    bool visit_ext(int8_t, BinType arg) { return this->touch(arg.data(), arg.size()); }
+
+    // Reads every payload byte, out of bounds spans show up under ASan
+    bool touch(const char* p, size_t size) {
+        for(size_t i = 0; i < size; ++i)
+            this->sum += static_cast<uint8_t>(p[i]);
+        return true;
+    }
+
+    uint64_t sum{};
+};
+
+// False when the stream is rejected
+bool stream(std::string_view s, size_t chunk) {
+    Visitor visitor;
+    msgpack::StreamingDecoder<Visitor> decoder{visitor};
+    std::string pending;
+
+    try {
+        for(size_t i = 0; i < s.size(); i += chunk) {
+            pending.append(s.substr(i, chunk));
+            pending.erase(0, decoder.feed(pending.data(), pending.size()));
+        }
+    }
+    catch(const std::runtime_error&) {
+        return false;
+    }
+
+    return pending.empty() && decoder.done();
+}
+
+// Message boundaries found by the pull decoder
+bool pull(std::string_view s) {
+    msgpack::BasicMsgPack<std::string_view> mp{s};
+    mp.set_max_alloc(MAX_ALLOC);
+
+    try {
+        while(!mp.at_end())
+            mp.skip();
+    }
+    catch(const std::runtime_error&) {
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if(!size)
+        return 0;
+
+    size_t chunk = 1 + (data[0] % 16);
+    std::string_view s{reinterpret_cast<const char*>(data + 1), size - 1};
+
+    bool whole = stream(s, s.size() ? s.size() : 1);
+    bool chunked = stream(s, chunk);
+
+    // Chunking never changes the outcome
+    check(whole == chunked);
+
+    if(whole)
+        check(msgpack::validate(s));
+    if(msgpack::validate(s))
+        check(pull(s));
+
+    return 0;
+}
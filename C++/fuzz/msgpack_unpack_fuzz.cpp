@@ -0,0 +1,92 @@
+// libFuzzer harness for BasicMsgPack::unpack(): the input is decoded into a
+// set of representative types, each from the start of the buffer. Decoding
+// errors are expected and ignored, crashes, sanitizer reports and allocations
+// past the budget are not.
+//
+// Build: clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -I.. msgpack_unpack_fuzz.cpp
+// Usage: ./a.out -max_len=65536 corpus/
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "msgpack.h"
+
+namespace {
+
+// Much larger than any input, small enough for length fields to not matter
+constexpr size_t MAX_ALLOC = 1 << 20;
+
+struct Point {
+    int64_t x;
+    int64_t y;
+    MSGPACK_DEFINE(x, y)
+};
+
+struct Record {
+    uint32_t id;
+    std::string name;
+    std::vector<double> values;
+    std::map<std::string, Point> points;
+    bool active;
+    MSGPACK_DEFINE_MAP(id, name, values, points, active)
+};
+
+template<typename T>
+void unpack_as(std::string_view data) {
+    msgpack::BasicMsgPack<std::string_view> mp{data};
+    mp.set_max_alloc(MAX_ALLOC);
+
+    try {
+        while(!mp.at_end()) {
+            T t{};
+            mp.unpack(t);
+        }
+    }
+    catch(const std::runtime_error&) {
+    }
+}
+
+void unpack_payloads(std::string_view data) {
+    msgpack::BasicMsgPack<std::string_view> mp{data};
+    mp.set_max_alloc(MAX_ALLOC);
+
+    try {
+        mp.unpack_bin_view();
+        mp.unpack_ext_view();
+        mp.unpack<msgpack::Timestamp>();
+        mp.skip();
+    }
+    catch(const std::runtime_error&) {
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string_view s{reinterpret_cast<const char*>(data), size};
+
+    unpack_as<int64_t>(s);
+    unpack_as<double>(s);
+    unpack_as<std::string>(s);
+    unpack_as<std::vector<int64_t>>(s);
+    unpack_as<std::vector<uint8_t>>(s);
+    unpack_as<std::vector<bool>>(s);
+    unpack_as<std::vector<std::string>>(s);
+    unpack_as<std::array<int32_t, 4>>(s);
+    unpack_as<std::set<int64_t>>(s);
+    unpack_as<std::map<std::string, std::vector<int64_t>>>(s);
+    unpack_as<std::unordered_map<int64_t, std::string>>(s);
+    unpack_as<std::tuple<int32_t, std::string, bool, double>>(s);
+    unpack_as<Point>(s);
+    unpack_as<Record>(s);
+    unpack_as<std::vector<Record>>(s);
+    unpack_payloads(s);
+    return 0;
+}
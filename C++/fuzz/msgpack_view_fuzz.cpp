@@ -0,0 +1,101 @@
+// libFuzzer harness for validate() and View: the input is validated with and
+// without an Index, the indexed elements and the first message are then
+// walked through View lookups and decoded. Valid input must decode without
+// reading past the buffer, invalid input must be rejected, never crash.
+//
+// Build: clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -I.. msgpack_view_fuzz.cpp
+// Usage: ./a.out -max_len=65536 corpus/
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "msgpack.h"
+
+namespace {
+
+constexpr size_t MAX_ALLOC = 1 << 20;
+constexpr size_t MAX_DEPTH = 64;
+
+void check(bool cond) {
+    if(!cond)
+        std::abort();
+}
+
+// Composite values are decoded from the element bytes on a budgeted
+// BasicMsgPack, View::as() would use the default one
+template<typename T>
+void decode(const msgpack::View& v) {
+    std::string_view bytes = v.raw();
+    msgpack::BasicMsgPack<std::string_view> mp{bytes};
+    mp.set_max_alloc(MAX_ALLOC);
+
+    try {
+        T t{};
+        mp.unpack(t);
+    }
+    catch(const std::runtime_error&) {
+    }
+}
+
+template<typename T>
+void scalar(const msgpack::View& v) {
+    try {
+        (void)v.as<T>();
+    }
+    catch(const std::runtime_error&) {
+    }
+}
+
+void walk(const msgpack::View& v) {
+    if(!v)
+        return;
+
+    scalar<bool>(v);
+    scalar<int8_t>(v);
+    scalar<uint64_t>(v);
+    scalar<int64_t>(v);
+    scalar<double>(v);
+    scalar<std::string_view>(v);
+    scalar<std::nullptr_t>(v);
+
+    decode<std::vector<int64_t>>(v);
+    decode<std::map<std::string, std::string>>(v);
+
+    (void)v[""];
+    (void)v["id"];
+    (void)v.at(0);
+    (void)v.at(v.size() ? v.size() - 1 : 0);
+    (void)v.at(v.size());
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string_view s{reinterpret_cast<const char*>(data), size};
+
+    bool valid = msgpack::validate(s, MAX_DEPTH);
+
+    msgpack::Index index;
+    check(msgpack::validate(s, index, 2, MAX_DEPTH) == valid);
+    check(valid || index.empty());
+
+    // Indexed elements and their Views agree on the extent and the children
+    for(size_t i = 0; i < index.size(); ++i) {
+        const msgpack::Index::Node& n = index[i];
+        msgpack::View v{data + n.offset, size - n.offset};
+
+        check(v && v.kind() == n.kind && v.raw().size() == n.end - n.offset);
+
+        if(const msgpack::Index::Node* item = index.item(n, 0))
+            check(v.at(0).raw().data() == s.data() + item->offset);
+
+        walk(v);
+    }
+
+    walk(msgpack::View{s});
+    return 0;
+}
@@ -0,0 +1,65 @@
+// libFuzzer harness for the iterative visit(): every message of the input is
+// walked with a visitor touching each event, nesting is capped below
+// MSGPACK_MAX_DEPTH so both depth limits are exercised.
+//
+// Build: clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -I.. msgpack_visit_fuzz.cpp
+// Usage: ./a.out -max_len=65536 corpus/
+
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <variant>
+#include "msgpack.h"
+
+namespace {
+
+constexpr size_t MAX_ALLOC = 1 << 20;
+constexpr size_t MAX_DEPTH = 64;
+
+struct Visitor: msgpack::BasicVisitor<std::string_view> {
+    bool start_map(size_t size) { return this->count(size); }
+    bool start_array(size_t size) { return this->count(size); }
+    bool visit_str(std::string_view arg) { return this->touch(arg.data(), arg.size()); }
+    bool visit_bin(BinType arg) { return this->touch(arg.data(), arg.size()); }
+    bool visit_ext(int8_t, BinType arg) { return this->touch(arg.data(), arg.size()); }
+
+    bool visit_int(IntegerType arg) {
+        std::visit([this](auto v) { this->sum += static_cast<uint64_t>(v); }, arg);
+        return true;
+    }
+
+    bool count(size_t size) {
+        this->sum += size;
+        return true;
+    }
+
+    // Reads every payload byte, out of bounds spans show up under ASan
+    bool touch(const char* p, size_t size) {
+        for(size_t i = 0; i < size; ++i)
+            this->sum += static_cast<uint8_t>(p[i]);
+        return true;
+    }
+
+    uint64_t sum{};
+};
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string_view s{reinterpret_cast<const char*>(data), size};
+
+    msgpack::BasicMsgPack<std::string_view> mp{s};
+    mp.set_max_alloc(MAX_ALLOC);
+    Visitor visitor;
+
+    try {
+        while(!mp.at_end()) {
+            if(!msgpack::impl::visit(mp, visitor, MAX_DEPTH))
+                break;
+        }
+    }
+    catch(const std::runtime_error&) {
+    }
+
+    return 0;
+}
@@ -7,10 +7,15 @@
 #include <optional>
 #include <random>
 #include <array>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 #include "error.h"
 
 #if defined(__unix__)
+    #include <cerrno>
     #include <fcntl.h>
     #include <unistd.h>
     #include <sys/mman.h>
@@ -18,12 +23,23 @@
     #error "Unsupported operating system"
 #endif
 
+#if defined(__linux__)
+    #include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+    #include <arm_acle.h>
+#endif
+
 
 namespace impl {
 
 template<typename> constexpr bool always_false_v = false;
 const std::string HASH_SUFFIX = ".hash";
 const std::string VALUE_SUFFIX = ".value";
+const std::string CHECKSUM_SUFFIX = ".checksum";
 
 #if defined(_WIN32)
     constexpr std::string_view PATH_SEPARATOR = "\\";
@@ -91,6 +107,45 @@ inline void read(file_h h, void* data, size_t nbytes) {
 #endif
 }
 
+// Pipes and sockets can transfer less than requested: loop until done
+inline void write_all(file_h h, const void* data, size_t nbytes) {
+#if defined(__unix__)
+    const char* p = static_cast<const char*>(data);
+
+    while(nbytes) {
+        ssize_t s = ::write(h, p, nbytes);
+        if(s == -1 && errno == EINTR) continue;
+        assume(s > 0);
+        p += s;
+        nbytes -= static_cast<size_t>(s);
+    }
+#endif
+}
+
+// Returns false on end of stream before the first byte
+inline bool read_all(file_h h, void* data, size_t nbytes) {
+#if defined(__unix__)
+    char* p = static_cast<char*>(data);
+    const size_t total = nbytes;
+
+    while(nbytes) {
+        ssize_t s = ::read(h, p, nbytes);
+        if(s == -1 && errno == EINTR) continue;
+        assume(s != -1);
+
+        if(s == 0) {
+            if(nbytes == total) return false;
+            except("Unexpected end of stream");
+        }
+
+        p += s;
+        nbytes -= static_cast<size_t>(s);
+    }
+
+    return true;
+#endif
+}
+
 inline file_o size(file_h h) {
     file_o o = impl::tell(h);
     impl::seek_end(h);
@@ -106,9 +161,15 @@ inline void resize(file_h h, size_t s) {
 }
 
 template<typename T>
-inline T* mmap(file_h h, size_t size) {
+inline T* mmap(file_h h, size_t size, [[maybe_unused]] bool populate = false) {
 #if defined(__unix__)
-    return reinterpret_cast<T*>(::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, h, 0));
+    int flags = MAP_SHARED;
+    #if defined(MAP_POPULATE)
+    if(populate) flags |= MAP_POPULATE;
+    #endif
+
+    void* m = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, h, 0);
+    return m != MAP_FAILED ? reinterpret_cast<T*>(m) : nullptr;
 #endif
 
 }
@@ -119,32 +180,109 @@ inline void munmap(void* m, [[maybe_unused]] size_t size) {
 #endif
 }
 
-inline size_t fnv1a(const void* data, size_t size) {
-    constexpr size_t FNV_OFFSET_BASIS = [](){
-        if constexpr(sizeof(size_t) == sizeof(uint64_t)) return 14695981039346656037ULL;
-        else return 2166136261U;
-    }();
+inline size_t page_size() {
+#if defined(__unix__)
+    static const size_t PAGE_SIZE = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return PAGE_SIZE;
+#endif
+}
 
-    constexpr size_t FNV_PRIME = [](){
-        if constexpr(sizeof(size_t) == sizeof(uint64_t)) return 1099511628211ULL;
-        else return 16777619U;
-    }();
+// Transparent huge pages are only honored where the kernel supports them
+// for the backing store (anonymous memory, tmpfs, or THP-enabled filesystems)
+inline void madvise_hugepage([[maybe_unused]] void* m, [[maybe_unused]] size_t size) {
+#if defined(MADV_HUGEPAGE)
+    ::madvise(m, size, MADV_HUGEPAGE);
+#endif
+}
+
+inline bool mlock([[maybe_unused]] const void* m, [[maybe_unused]] size_t size) {
+#if defined(__unix__)
+    return ::mlock(m, size) == 0;
+#endif
+}
+
+enum numa_policy {
+    numa_policy_default = 0,
+    numa_policy_bind = 2,       // MPOL_BIND
+    numa_policy_interleave = 3, // MPOL_INTERLEAVE
+};
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_set_mempolicy) && defined(SYS_getcpu)
+// Nodemask for the policy: every node for interleave (the kernel clamps it to
+// the allowed ones), the node of the calling CPU for bind. Computed on the
+// opening thread only, a worker would bind to wherever it happens to run
+inline unsigned long numa_nodemask(numa_policy p) {
+    if(p == numa_policy_default) return 0;
+    if(p == numa_policy_interleave) return ~0UL;
+
+    unsigned int cpu = 0, node = 0;
+    if(::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) node = 0;
+    return 1UL << node;
+}
+
+inline void numa_mbind(void* m, size_t size, numa_policy p, unsigned long mask) {
+    if(p == numa_policy_default) return;
+    ::syscall(SYS_mbind, m, size, static_cast<int>(p), &mask, sizeof(mask) * 8, 0);
+}
+
+inline void numa_thread_policy(numa_policy p, unsigned long mask) {
+    if(p == numa_policy_default) return;
+    ::syscall(SYS_set_mempolicy, static_cast<int>(p), &mask, sizeof(mask) * 8);
+}
+#else
+inline unsigned long numa_nodemask(numa_policy) { return 0; }
+inline void numa_mbind(void*, size_t, numa_policy, unsigned long) { }
+inline void numa_thread_policy(numa_policy, unsigned long) { }
+#endif
+
+// Fault in every page of the mapping, one slice per hardware thread.
+// mbind() is ignored for pages of regular files, they follow the policy of
+// the thread that faults them: apply it to the workers too, with the mask
+// of the calling thread
+inline void prefault(const void* m, size_t size, numa_policy p = numa_policy_default,
+                     unsigned long mask = 0) {
+    const size_t pagesize = impl::page_size();
+    const size_t npages = (size + pagesize - 1) / pagesize;
+    size_t nthreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    nthreads = std::min(nthreads, std::max<size_t>(npages, 1));
+
+    const size_t slice = (npages + nthreads - 1) / nthreads;
+    const volatile unsigned char* base = static_cast<const volatile unsigned char*>(m);
+    std::vector<std::thread> workers;
+    workers.reserve(nthreads);
+
+    for(size_t t = 0; t < nthreads; ++t) {
+        workers.emplace_back([=]() {
+            impl::numa_thread_policy(p, mask);
+
+            size_t first = t * slice, last = std::min(first + slice, npages);
+            for(size_t i = first; i < last; ++i) (void)base[i * pagesize];
+        });
+    }
+
+    for(std::thread& w : workers) w.join();
+}
 
-    size_t h = FNV_OFFSET_BASIS;
+// Always 64-bit: bucket placement must not depend on the architecture
+inline uint64_t fnv1a(const void* data, size_t size) {
+    constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+    uint64_t h = FNV_OFFSET_BASIS;
     const unsigned char* p = static_cast<const unsigned char*>(data);
     const unsigned char* const end = p + size;
 
     for( ; p != end; ++p) {
-        h ^= static_cast<size_t>(*p);
+        h ^= static_cast<uint64_t>(*p);
         h *= FNV_PRIME;
     }
 
     return h;
 }
 
-inline size_t fnv1a(std::string_view value) { return impl::fnv1a(value.data(), value.size()); }
+inline uint64_t fnv1a(std::string_view value) { return impl::fnv1a(value.data(), value.size()); }
 
-inline size_t fnv1a(float value) {
+inline uint64_t fnv1a(float value) {
     static_assert(std::numeric_limits<float>::is_iec559,
         "fnv1a is only defined for IEEE 754-compliant floating-point types");
     static_assert(sizeof(value) == sizeof(uint32_t),
@@ -155,7 +293,7 @@ inline size_t fnv1a(float value) {
     return impl::fnv1a(&bits, sizeof(bits));
 }
 
-inline size_t fnv1a(double value) {
+inline uint64_t fnv1a(double value) {
     static_assert(std::numeric_limits<double>::is_iec559,
         "fnv1a is only defined for IEEE 754-compliant floating-point types");
     static_assert(sizeof(value) == sizeof(uint64_t),
@@ -166,19 +304,119 @@ inline size_t fnv1a(double value) {
     return impl::fnv1a(&bits, sizeof(bits));
 }
 
+// Fixed-width little-endian field without alignment requirements:
+// structures made of these have the same layout on every architecture
+template<typename T>
+struct le {
+    static_assert(std::is_trivially_copyable_v<T>, "le<T> requires a trivially copyable type");
+
+    unsigned char bytes[sizeof(T)];
+
+    operator T() const {
+        T t;
+        unsigned char b[sizeof(T)];
+        std::copy_n(bytes, sizeof(T), b);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        if constexpr(std::is_arithmetic_v<T>) std::reverse(b, b + sizeof(T));
+#endif
+        std::memcpy(&t, b, sizeof(T));
+        return t;
+    }
+
+    le& operator=(T t) {
+        std::memcpy(bytes, &t, sizeof(T));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        if constexpr(std::is_arithmetic_v<T>) std::reverse(bytes, bytes + sizeof(T));
+#endif
+        return *this;
+    }
+
+    le& operator+=(T t) { return *this = static_cast<T>(static_cast<T>(*this) + t); }
+    le& operator-=(T t) { return *this = static_cast<T>(static_cast<T>(*this) - t); }
+    le& operator<<=(int n) { return *this = static_cast<T>(static_cast<T>(*this) << n); }
+    le& operator++() { return *this += 1; }
+    le& operator--() { return *this -= 1; }
+};
+
+constexpr uint32_t CRC32C_POLY = 0x82f63b78;
+
+constexpr std::array<uint32_t, 256> CRC32C_TABLE = [](){
+    std::array<uint32_t, 256> t{};
+
+    for(uint32_t i = 0; i < t.size(); ++i) {
+        uint32_t c = i;
+        for(int j = 0; j < 8; ++j) c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : (c >> 1);
+        t[i] = c;
+    }
+
+    return t;
+}();
+
+inline uint32_t crc32c_sw(uint32_t crc, const unsigned char* p, size_t size) {
+    for( ; size; --size, ++p) crc = CRC32C_TABLE[(crc ^ *p) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("sse4.2")))
+inline uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, size_t size) {
+    uint64_t c = crc;
+
+    for( ; size >= sizeof(uint64_t); size -= sizeof(uint64_t), p += sizeof(uint64_t)) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+
+    crc = static_cast<uint32_t>(c);
+    for( ; size; --size, ++p) crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+#elif defined(__ARM_FEATURE_CRC32)
+inline uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, size_t size) {
+    for( ; size >= sizeof(uint64_t); size -= sizeof(uint64_t), p += sizeof(uint64_t)) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+    }
+
+    for( ; size; --size, ++p) crc = __crc32cb(crc, *p);
+    return crc;
+}
+#endif
+
+inline uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    static const bool HAS_SSE42 = __builtin_cpu_supports("sse4.2");
+    crc = HAS_SSE42 ? impl::crc32c_hw(crc, p, size) : impl::crc32c_sw(crc, p, size);
+#elif defined(__ARM_FEATURE_CRC32)
+    crc = impl::crc32c_hw(crc, p, size);
+#else
+    crc = impl::crc32c_sw(crc, p, size);
+#endif
+
+    return ~crc;
+}
+
 struct Serializer {
     template<typename T, typename Reader>
     static void deserialize(T& t, Reader r) {
         using U = std::decay_t<T>;
 
-        if constexpr(std::is_integral_v<U> || std::is_floating_point_v<U>)
-            r(reinterpret_cast<void*>(&t), sizeof(T));
+        if constexpr(std::is_integral_v<U> || std::is_floating_point_v<U>) {
+            impl::le<U> v;
+            r(reinterpret_cast<void*>(&v), sizeof(v));
+            t = v;
+        }
         else if constexpr(std::is_same_v<U, std::string>) {
-            std::string::size_type size;
-            r(reinterpret_cast<void*>(&size), sizeof(std::string::size_type));
+            impl::le<uint64_t> size;
+            r(reinterpret_cast<void*>(&size), sizeof(size));
 
             t.resize(size);
-            r(reinterpret_cast<void*>(t.data()), size);
+            r(reinterpret_cast<void*>(t.data()), t.size());
         }
         else
             t.deserialize(r);
@@ -188,11 +426,15 @@ struct Serializer {
     static void serialize(T&& t, Writer w) {
         using U = std::decay_t<T>;
 
-        if constexpr(std::is_integral_v<U> || std::is_floating_point_v<U>)
-            w(reinterpret_cast<void*>(&t), sizeof(T));
+        if constexpr(std::is_integral_v<U> || std::is_floating_point_v<U>) {
+            impl::le<U> v;
+            v = t;
+            w(reinterpret_cast<const void*>(&v), sizeof(v));
+        }
         else if constexpr(std::is_same_v<U, std::string>) {
-            std::string::size_type size = t.size();
-            w(reinterpret_cast<void*>(&size), sizeof(std::string::size_type));
+            impl::le<uint64_t> size;
+            size = t.size();
+            w(reinterpret_cast<const void*>(&size), sizeof(size));
             w(t.c_str(), t.size());
         }
         else
@@ -203,9 +445,23 @@ struct Serializer {
 } // namespace impl
 
 enum hashdb_flags {
-    hashdb_flags_none   = 0,
-    hashdb_flags_split  = (1 << 0),
-    hashdb_flags_remove = (1 << 1),
+    hashdb_flags_none            = 0,
+    hashdb_flags_split           = (1 << 0),
+    hashdb_flags_remove          = (1 << 1),
+    hashdb_flags_hugepage        = (1 << 2), // madvise(MADV_HUGEPAGE) the slot table
+    hashdb_flags_populate        = (1 << 3), // Prefault the slot table (MAP_POPULATE, after mbind() with a NUMA policy)
+    hashdb_flags_lock            = (1 << 4), // Pin the slot table in RAM with mlock()
+    hashdb_flags_warmup          = (1 << 5), // Touch every page of the slot table in parallel
+    hashdb_flags_numa_interleave = (1 << 6), // Interleave the slot table across NUMA nodes
+    hashdb_flags_numa_bind       = (1 << 7), // Bind the slot table to the node of the mapping thread
+    hashdb_flags_checksum        = (1 << 8), // Verify the slot table against per-region checksums
+    hashdb_flags_offset32        = (1 << 9), // 32-bit value offsets, value file limited to 4 GiB
+};
+
+enum hashdb_op : unsigned char {
+    hashdb_op_set = 1,
+    hashdb_op_erase,
+    hashdb_op_clear,
 };
 
 template<typename K, typename V, size_t Flags = hashdb_flags_none, typename Serializer = impl::Serializer>
@@ -213,29 +469,99 @@ class HashDB
 {
     using Self = HashDB<K, V, Flags, Serializer>;
 
+    static_assert(std::is_trivially_copyable_v<K>, "HashDB keys are stored in the mapped slot table");
+
     static constexpr bool SPLIT_VALUE = (Flags & hashdb_flags_split) || (sizeof(V) > sizeof(uintptr_t));
-    static constexpr size_t SIGNATURE = 0x5d1b0239;
+    static constexpr bool CHECKSUM = Flags & hashdb_flags_checksum;
+    static constexpr size_t CHECKSUM_REGION = 1 << 20;
+    static constexpr size_t DEFAULT_FEED_BATCH = 64 * 1024;
+    static constexpr uint32_t SIGNATURE = 0x5d1b0239;
+    static constexpr uint8_t FORMAT_VERSION = 2; // Version 1: native integers and padding
+    static constexpr uint8_t LAYOUT_SPLIT = 1 << 0;
+    static constexpr uint8_t LAYOUT_OFFSET32 = 1 << 1;
+    static constexpr uint8_t LAYOUT_FLAGS = (SPLIT_VALUE ? LAYOUT_SPLIT : 0) | ((Flags & hashdb_flags_offset32) ? LAYOUT_OFFSET32 : 0);
     static constexpr size_t DEFAULT_ITEMS_COUNT = 4096;
     static constexpr float MAX_FILL_CAPACITY = 0.75;
 
+    static constexpr impl::numa_policy NUMA_POLICY = [](){
+        if constexpr(Flags & hashdb_flags_numa_interleave) return impl::numa_policy_interleave;
+        else if constexpr(Flags & hashdb_flags_numa_bind) return impl::numa_policy_bind;
+        else return impl::numa_policy_default;
+    }();
+
     enum {
         STATE_EMPTY = 0,
         STATE_TOMBSTONE,
         STATE_FULL,
     };
 
-    struct hash_offset_value {
+    enum : uint8_t {
+        REGION_UNVERIFIED = 0,
+        REGION_VERIFYING,
+        REGION_VERIFIED,
+    };
+
+    using offset_t = std::conditional_t<Flags & hashdb_flags_offset32, uint32_t, uint64_t>;
+
+    // Split values pack the slot state in the two high bits of the value capacity
+    struct split_pair {
+        static constexpr int STATE_SHIFT = 30;
+        static constexpr uint32_t CAPACITY_MASK = (1U << STATE_SHIFT) - 1;
+
+        impl::le<K> key;
+        impl::le<uint32_t> capstate;
+        impl::le<offset_t> offset;
+
+        uint8_t state() const { return static_cast<uint8_t>(capstate >> STATE_SHIFT); }
+        void set_state(uint8_t s) { capstate = (capstate & CAPACITY_MASK) | (static_cast<uint32_t>(s) << STATE_SHIFT); }
+        uint32_t capacity() const { return capstate & CAPACITY_MASK; }
+        void set_capacity(uint32_t c) { capstate = (capstate & ~CAPACITY_MASK) | c; }
+    };
+
+    struct inline_pair {
+        impl::le<uint8_t> packedstate;
+        impl::le<K> key;
+        impl::le<V> value;
+
+        uint8_t state() const { return packedstate; }
+        void set_state(uint8_t s) { packedstate = s; }
+    };
+
+    using kv_pair = std::conditional_t<SPLIT_VALUE, split_pair, inline_pair>;
+
+    struct hash_header {
+        impl::le<uint32_t> signature;
+        impl::le<uint8_t> version;
+        impl::le<uint8_t> keysize;
+        impl::le<uint8_t> pairsize;
+        impl::le<uint8_t> layout; // LAYOUT_* bits
+        impl::le<uint64_t> capacity;
+        impl::le<uint64_t> size;
+        impl::le<uint64_t> fill;
+        impl::le<uint64_t> valuecapacity;
+        impl::le<uint64_t> valuesize;
+    };
+
+    // Format version 1, upgraded by load(). It stored native integers, size_t string lengths and
+    // size_t-wide hashes: only 64-bit little-endian hosts read it the way version 2 does
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    static constexpr bool LEGACY_UPGRADE = false;
+#else
+    static constexpr bool LEGACY_UPGRADE = sizeof(size_t) == sizeof(uint64_t);
+#endif
+
+    struct legacy_offset_value {
         size_t capacity;
         size_t offset;
     };
 
-    struct kv_pair {
+    struct legacy_kv_pair {
         size_t state;
         K key;
-        std::conditional_t<SPLIT_VALUE, hash_offset_value, V> value;
+        std::conditional_t<SPLIT_VALUE, legacy_offset_value, V> value;
     };
 
-    struct hash_header {
+    struct legacy_header {
         unsigned char integersize;
         size_t signature;
         size_t capacity;
@@ -245,11 +571,29 @@ class HashDB
         size_t valuesize;
     };
 
+    // Sidecar layout: header followed by one crc32c per CHECKSUM_REGION bytes of slots.
+    // 'clean' is cleared on the first write after a sync and set again by the next one
+    struct checksum_header {
+        impl::le<uint32_t> signature;
+        impl::le<uint32_t> regionsize;
+        impl::le<uint64_t> capacity;
+        impl::le<uint64_t> clean;
+    };
+
+    // Change feed frame: header followed by 'count' records of 'size' bytes in total.
+    // Record: hashdb_op, serialized key, serialized value (hashdb_op_set only)
+    struct feed_header {
+        impl::le<uint32_t> signature;
+        impl::le<uint32_t> count;
+        impl::le<uint32_t> size;
+        impl::le<uint32_t> checksum;
+    };
+
     struct value_getter {
         value_getter(const Self* s, const kv_pair* e): m_self{s}, m_e{e} { }
 
         V operator*() const {
-            assume(m_e && m_e->state == STATE_FULL);
+            assume(m_e && m_e->state() == STATE_FULL);
 
             V v;
             assume(m_self->get_value(*m_e, v));
@@ -269,7 +613,7 @@ class HashDB
         iterator& operator++() {
             if(m_e != m_ende) {
                 ++m_e;
-                while(m_e != m_ende && m_e->state != STATE_FULL) ++m_e;
+                while(m_e != m_ende && !m_self->is_full(m_e)) ++m_e;
             }
 
             return *this;
@@ -311,6 +655,8 @@ public:
     }
 
     void close() {
+        this->flush_feed();
+        if(m_hash) this->sync();
         if(m_hash) impl::munmap(m_hash, m_hash->capacity * sizeof(kv_pair));
         if(m_fhash != impl::INVALID_HANDLE) impl::close(m_fhash);
         if(m_fvalue != impl::INVALID_HANDLE) impl::close(m_fvalue);
@@ -322,8 +668,10 @@ public:
         if constexpr(Flags & hashdb_flags_remove) {
             if(!m_fvaluepath.empty()) std::remove(m_fvaluepath.c_str());
             if(!m_fhashpath.empty()) std::remove(m_fhashpath.c_str());
+            if(!m_fchecksumpath.empty()) std::remove(m_fchecksumpath.c_str());
             m_fvaluepath.clear();
             m_fhashpath.clear();
+            m_fchecksumpath.clear();
         }
     }
 
@@ -333,13 +681,7 @@ public:
 
         m_fhashpath = basepath + name + ".hash";
         this->reinit_hashfile(DEFAULT_ITEMS_COUNT, true);
-
-        m_hash->integersize = sizeof(size_t);
-        m_hash->signature = SIGNATURE;
-        m_hash->capacity = DEFAULT_ITEMS_COUNT;
-        m_hash->valuesize = 0;
-        m_hash->size = 0;
-        m_hash->fill = 0;
+        Self::init_header(m_hash, DEFAULT_ITEMS_COUNT);
 
         if constexpr(SPLIT_VALUE) {
             m_fvaluepath = basepath + name + impl::VALUE_SUFFIX;
@@ -348,12 +690,17 @@ public:
         }
         else
             m_hash->valuecapacity = 0;
+
+        if constexpr(CHECKSUM) {
+            m_fchecksumpath = m_fhashpath + impl::CHECKSUM_SUFFIX;
+            this->reset_checksums();
+        }
     }
 
     iterator begin() const {
         kv_pair* e = this->get_kvpairs();
         kv_pair* ee = this->get_kvpairs() + m_hash->capacity;
-        while(e != ee && e->state != STATE_FULL) e++;
+        while(e != ee && !this->is_full(e)) e++;
         return iterator{this, e, ee};
     }
 
@@ -369,30 +716,35 @@ public:
 
     bool contains(K k) const {
         const kv_pair& e = this->get_entry(k);
-        return e.state == STATE_FULL;
+        return e.state() == STATE_FULL;
     }
 
     void clear() {
         kv_pair* kv = this->get_kvpairs();
         std::fill_n(reinterpret_cast<char*>(kv), m_hash->capacity * sizeof(kv_pair), 0);
         m_hash->fill = m_hash->size = m_hash->valuesize = 0;
+        if constexpr(CHECKSUM) this->reset_checksums();
+        this->record(hashdb_op_clear, nullptr, nullptr);
     }
 
     void erase(K k) {
         kv_pair& e = this->get_entry(k);
-        if(e.state != STATE_FULL) return;
+        if(e.state() != STATE_FULL) return;
+        this->touch_slot(&e);
         --m_hash->size;
-        e.state = STATE_TOMBSTONE;
+        e.set_state(STATE_TOMBSTONE);
+        this->record(hashdb_op_erase, &k, nullptr);
     }
 
     void set(K k, const V& v) {
         this->check_rehash();
 
         kv_pair& e = this->get_entry(k);
+        this->touch_slot(&e);
         e.key = k;
 
-        if(e.state != STATE_FULL) ++m_hash->size;
-        if(e.state == STATE_EMPTY) ++m_hash->fill;
+        if(e.state() != STATE_FULL) ++m_hash->size;
+        if(e.state() == STATE_EMPTY) ++m_hash->fill;
 
         if constexpr(SPLIT_VALUE) {
             size_t n = 0;
@@ -404,21 +756,27 @@ public:
                 n += size;
             });
 
-            if(e.state == STATE_EMPTY || n > e.value.capacity) {
+            if(n > kv_pair::CAPACITY_MASK) except("Value of {} bytes is too large", n);
+
+            if(e.state() == STATE_EMPTY || n > e.capacity()) {
+                if(m_hash->valuesize + n > std::numeric_limits<offset_t>::max())
+                    except("Value file '{}' exceeds its offset size", m_fvaluepath);
+
                 if(this->values_filled() > MAX_FILL_CAPACITY) this->extend_value();
-                e.value.capacity = n;
-                e.value.offset = impl::seek(m_fvalue, m_hash->valuesize);
+                e.set_capacity(static_cast<uint32_t>(n));
+                e.offset = static_cast<offset_t>(impl::seek(m_fvalue, m_hash->valuesize));
                 m_hash->valuesize += n;
             }
             else
-                impl::seek(m_fvalue, e.value.offset);
+                impl::seek(m_fvalue, e.offset);
 
             impl::write(m_fvalue, m_wbuffer.data(), n);
         }
         else
             e.value = v;
 
-        e.state = STATE_FULL;
+        e.set_state(STATE_FULL);
+        this->record(hashdb_op_set, &k, &v);
     }
 
     void set(K k, V&& v) { this->set(k, std::move(v)); }
@@ -439,6 +797,7 @@ public:
         if(this->empty()) return;
 
         this->check_rehash();
+        this->verify();
 
         if constexpr(SPLIT_VALUE) {
             std::string tmpvalue = m_fvaluepath + ".tmp";
@@ -450,17 +809,18 @@ public:
             impl::file_o offset = 0;
 
             for(size_t i = 0; i < m_hash->capacity; ++i, ++e) {
-                if(e->state != STATE_FULL) continue;
+                if(e->state() != STATE_FULL) continue;
 
-                if(m_wbuffer.size() < e->value.capacity)
-                    m_wbuffer.resize(e->value.capacity);
+                if(m_wbuffer.size() < e->capacity())
+                    m_wbuffer.resize(e->capacity());
 
-                impl::seek(m_fvalue, e->value.offset);
-                impl::read(m_fvalue, m_wbuffer.data(), e->value.capacity);
-                e->value.offset = offset;
+                impl::seek(m_fvalue, e->offset);
+                impl::read(m_fvalue, m_wbuffer.data(), e->capacity());
+                this->touch_slot(e);
+                e->offset = static_cast<offset_t>(offset);
 
-                impl::write(newfile, m_wbuffer.data(), e->value.capacity);
-                offset += e->value.capacity;
+                impl::write(newfile, m_wbuffer.data(), e->capacity());
+                offset += e->capacity();
             }
 
             m_hash->valuesize = offset;
@@ -474,12 +834,25 @@ public:
         }
     }
 
-    void rehash() {
+    // Grow the slot table once, so that 'n' items fit without further rehashes
+    void reserve(size_t n) {
+        size_t newcapacity = m_hash->capacity;
+
+        while(static_cast<float>(n) > static_cast<float>(newcapacity) * MAX_FILL_CAPACITY)
+            newcapacity <<= 1;
+
+        if(newcapacity != m_hash->capacity) this->rehash(newcapacity);
+    }
+
+    void rehash() { this->rehash(m_hash->capacity << 1); }
+
+    void rehash(size_t newcapacity) {
         assume(!m_fhashpath.empty());
         assume(m_fhash != impl::INVALID_HANDLE);
         assume(m_hash);
+        assume(newcapacity > m_hash->size);
+        this->verify();
 
-        size_t newcapacity = m_hash->capacity << 1;
         size_t newsize = sizeof(hash_header) + (newcapacity * sizeof(kv_pair));
         std::string tmphash = m_fhashpath + ".tmp";
         impl::file_h newfile = impl::open(tmphash);
@@ -495,9 +868,10 @@ public:
         kv_pair* oldpair = this->get_kvpairs();
 
         for(size_t i = 0; i < m_hash->capacity; ++i, ++oldpair) {
-            if(oldpair->state != STATE_FULL) continue;
+            if(oldpair->state() != STATE_FULL) continue;
 
             size_t idx = this->hash(oldpair->key) % newhash->capacity;
+            while(newpair[idx].state() == STATE_FULL) idx = (idx + 1) % newhash->capacity;
             newpair[idx] = *oldpair;
         }
 
@@ -511,28 +885,160 @@ public:
         std::remove(m_fhashpath.c_str());
         std::rename(tmphash.c_str(), m_fhashpath.c_str());
         this->reinit_hashfile(newcapacity);
+        if constexpr(CHECKSUM) this->reset_checksums();
     }
 
-    static Self load(const std::string& name, std::string basepath = std::string{}) {
+    // Stream every change to 'h' (a pipe, socket or file), batchsize bytes per frame
+    void feed(impl::file_h h, size_t batchsize = DEFAULT_FEED_BATCH) {
+        this->flush_feed();
+        m_ffeed = h;
+        m_feedbatch = batchsize;
+    }
+
+    void flush_feed() {
+        if(m_ffeed == impl::INVALID_HANDLE || !m_feedcount) return;
+
+        feed_header header;
+        header.signature = SIGNATURE;
+        header.count = m_feedcount;
+        header.size = static_cast<uint32_t>(m_feedbuffer.size());
+        header.checksum = impl::crc32c(m_feedbuffer.data(), m_feedbuffer.size());
+
+        impl::write_all(m_ffeed, &header, sizeof(feed_header));
+        impl::write_all(m_ffeed, m_feedbuffer.data(), m_feedbuffer.size());
+        m_feedbuffer.clear();
+        m_feedcount = 0;
+    }
+
+    // Read a single frame of a change feed from 'h' and replay it, false at end of stream
+    bool apply(impl::file_h h) {
+        feed_header header;
+        if(!impl::read_all(h, &header, sizeof(feed_header))) return false;
+        if(header.signature != SIGNATURE) except("Invalid feed signature");
+
+        m_feedrbuffer.resize(header.size);
+        if(!impl::read_all(h, m_feedrbuffer.data(), header.size)) except("Truncated feed frame");
+        if(impl::crc32c(m_feedrbuffer.data(), header.size) != header.checksum) except("Feed frame checksum mismatch");
+
+        const char* p = m_feedrbuffer.data();
+        const char* const end = p + header.size;
+
+        auto reader = [&](void* data, size_t size) {
+            if(size > static_cast<size_t>(end - p)) except("Malformed feed frame");
+            std::copy_n(p, size, reinterpret_cast<char*>(data));
+            p += size;
+        };
+
+        for(uint32_t i = 0; i < header.count; ++i) {
+            unsigned char op;
+            reader(&op, sizeof(op));
+
+            if(op == hashdb_op_clear) {
+                this->clear();
+                continue;
+            }
+
+            impl::le<K> key;
+            reader(&key, sizeof(key));
+            K k = key;
+
+            switch(op) {
+                case hashdb_op_set: {
+                    V v;
+
+                    if constexpr(SPLIT_VALUE) Serializer::deserialize(v, reader);
+                    else {
+                        impl::le<V> value;
+                        reader(&value, sizeof(value));
+                        v = value;
+                    }
+
+                    this->set(k, v);
+                    break;
+                }
+
+                case hashdb_op_erase: this->erase(k); break;
+                default: except("Invalid feed operation {}", op);
+            }
+        }
+
+        return true;
+    }
+
+    // Verify every region not checked yet, in parallel.
+    // Can run from a background thread while the table is being served
+    void verify(size_t nthreads = 0) const {
+        if constexpr(CHECKSUM) {
+            if(!nthreads) nthreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            nthreads = std::min(nthreads, std::max<size_t>(m_nregions, 1));
+
+            std::vector<std::thread> workers;
+            workers.reserve(nthreads);
+
+            for(size_t t = 0; t < nthreads; ++t) {
+                workers.emplace_back([this, t, nthreads]() {
+                    for(size_t r = t; r < m_nregions; r += nthreads)
+                        this->verify_region(r);
+                });
+            }
+
+            for(std::thread& w : workers) w.join();
+        }
+    }
+
+    // Refresh the checksums of the modified regions and mark the sidecar as clean
+    void sync() {
+        if constexpr(CHECKSUM) {
+            if(m_checksumclean) return;
+
+            for(size_t r = 0; r < m_nregions; ++r) {
+                if(!m_dirtyregions[r]) continue;
+                m_checksums[r] = this->region_checksum(r);
+                m_dirtyregions[r] = false;
+            }
+
+            this->write_checksums(true);
+        }
+    }
+
+    // A checksummed table whose sidecar is missing or was not closed cleanly can't be verified:
+    // loading it throws unless 'rebuildchecksums' accepts the current contents as good
+    static Self load(const std::string& name, std::string basepath = std::string{}, bool rebuildchecksums = false) {
         assume(!name.empty());
         if(!basepath.empty()) basepath.append(impl::PATH_SEPARATOR);
 
         std::string hashpath = basepath + name + impl::HASH_SUFFIX;
         if(!impl::is_file(hashpath)) except("Hash file '{}' not found", hashpath);
-        return Self{impl::open(hashpath), name, basepath};
+        return Self{impl::open(hashpath), name, basepath, rebuildchecksums};
     }
 
 private:
-    HashDB(impl::file_h fhash, [[maybe_unused]] const std::string& name, [[maybe_unused]] const std::string basepath): m_fhash{fhash} {
+    HashDB(impl::file_h fhash, [[maybe_unused]] const std::string& name, [[maybe_unused]] const std::string basepath,
+           [[maybe_unused]] bool rebuildchecksums): m_fhash{fhash} {
         assume(m_fhash != impl::INVALID_HANDLE);
-        m_fhashpath = basepath + impl::HASH_SUFFIX;
+        m_fhashpath = basepath + name + impl::HASH_SUFFIX;
 
         size_t size = impl::size(fhash);
-        m_hash = impl::mmap<hash_header>(m_fhash, size);
+        m_hash = this->map_hashfile(size);
         assume(m_hash);
 
-        if(m_hash->integersize != sizeof(size_t)) except("Unexpected integer size");
-        if(m_hash->signature != SIGNATURE) except("Invalid signature");
+        // Pick the decoder from the header: version 1 tables are upgraded in place
+        const auto* legacy = reinterpret_cast<const legacy_header*>(m_hash);
+
+        if(m_hash->signature != SIGNATURE) {
+            if(legacy->signature != SIGNATURE) except("Invalid signature");
+            if(legacy->integersize != sizeof(size_t)) except("Unexpected integer size");
+            if(!LEGACY_UPGRADE) except("'{}' is a version 1 table, it can only be upgraded on a 64-bit little-endian host", m_fhashpath);
+            this->upgrade_legacy(size);
+            rebuildchecksums = true; // Version 1 tables have no checksums
+        }
+
+        if(m_hash->version != FORMAT_VERSION) except("Unsupported format version {}", static_cast<int>(m_hash->version));
+
+        if(m_hash->keysize != sizeof(K) || m_hash->pairsize != sizeof(kv_pair) || m_hash->layout != LAYOUT_FLAGS)
+            except("'{}' has an incompatible slot layout", m_fhashpath);
+
+        if constexpr(CHECKSUM) this->load_checksums(rebuildchecksums);
 
         if constexpr(SPLIT_VALUE) {
             m_fvaluepath = basepath + name + impl::VALUE_SUFFIX;
@@ -542,14 +1048,110 @@ private:
         }
     }
 
+    void record(hashdb_op op, const K* k, const V* v) {
+        if(m_ffeed == impl::INVALID_HANDLE) return;
+
+        auto writer = [&](const void* data, size_t size) {
+            m_feedbuffer.append(reinterpret_cast<const char*>(data), size);
+        };
+
+        m_feedbuffer.push_back(static_cast<char>(op));
+
+        // Keys and inline values as the slot stores them, split values as serialized by set()
+        if(k) {
+            impl::le<K> key;
+            key = *k;
+            writer(&key, sizeof(key));
+        }
+
+        if(v) {
+            if constexpr(SPLIT_VALUE) m_feedbuffer.append(m_wbuffer);
+            else {
+                impl::le<V> value;
+                value = *v;
+                writer(&value, sizeof(value));
+            }
+        }
+
+        ++m_feedcount;
+        if(m_feedbuffer.size() >= m_feedbatch) this->flush_feed();
+    }
+
+    static void init_header(hash_header* h, size_t capacity) {
+        h->signature = SIGNATURE;
+        h->version = FORMAT_VERSION;
+        h->keysize = sizeof(K);
+        h->pairsize = sizeof(kv_pair);
+        h->layout = LAYOUT_FLAGS;
+        h->capacity = capacity;
+        h->valuesize = 0;
+        h->size = 0;
+        h->fill = 0;
+    }
+
+    // Rewrite a version 1 table slot by slot: with LEGACY_UPGRADE indices, hashes and the value file don't change
+    void upgrade_legacy(size_t oldsize) {
+        SPDLOG_WARN("Upgrading '{}' to format version {}", m_fhashpath, FORMAT_VERSION);
+
+        const auto* oldhash = reinterpret_cast<const legacy_header*>(m_hash);
+        const auto* oldpair = reinterpret_cast<const legacy_kv_pair*>(oldhash + 1);
+        const size_t capacity = oldhash->capacity;
+        assume(oldsize >= sizeof(legacy_header) + (capacity * sizeof(legacy_kv_pair)));
+
+        size_t newsize = sizeof(hash_header) + (capacity * sizeof(kv_pair));
+        std::string tmphash = m_fhashpath + ".tmp";
+        impl::file_h newfile = impl::open(tmphash);
+        assume(newfile != impl::INVALID_HANDLE);
+        impl::resize(newfile, newsize);
+
+        hash_header* newhash = impl::mmap<hash_header>(newfile, newsize);
+        assume(newhash);
+        Self::init_header(newhash, capacity);
+        newhash->size = oldhash->size;
+        newhash->fill = oldhash->fill;
+        newhash->valuecapacity = oldhash->valuecapacity;
+        newhash->valuesize = oldhash->valuesize;
+
+        kv_pair* newpair = reinterpret_cast<kv_pair*>(newhash + 1);
+
+        for(size_t i = 0; i < capacity; ++i, ++oldpair) {
+            if(oldpair->state == STATE_EMPTY) continue;
+
+            newpair[i].key = oldpair->key;
+
+            if constexpr(SPLIT_VALUE) {
+                if(oldpair->value.capacity > kv_pair::CAPACITY_MASK || oldpair->value.offset > std::numeric_limits<offset_t>::max())
+                    except("'{}' doesn't fit the current slot layout", m_fhashpath);
+
+                newpair[i].set_capacity(static_cast<uint32_t>(oldpair->value.capacity));
+                newpair[i].offset = static_cast<offset_t>(oldpair->value.offset);
+            }
+            else
+                newpair[i].value = oldpair->value;
+
+            newpair[i].set_state(static_cast<uint8_t>(oldpair->state));
+        }
+
+        impl::munmap(newhash, newsize);
+        impl::close(newfile);
+
+        impl::munmap(m_hash, oldsize);
+        impl::close(m_fhash);
+        std::remove(m_fhashpath.c_str());
+        std::remove((m_fhashpath + impl::CHECKSUM_SUFFIX).c_str()); // Stale, rebuilt after the upgrade
+        std::rename(tmphash.c_str(), m_fhashpath.c_str());
+        this->reinit_hashfile(capacity);
+    }
+
     kv_pair* get_kvpairs() const { return reinterpret_cast<kv_pair*>(m_hash + 1); }
+    bool is_full(const kv_pair* e) const { this->verify_slot(e); return e->state() == STATE_FULL; }
     float values_filled() { return static_cast<float>(m_hash->valuesize) / static_cast<float>(m_hash->valuecapacity); }
 
     bool get_value(const kv_pair& e, V& v) const {
-        if(e.state != STATE_FULL) return false;
+        if(e.state() != STATE_FULL) return false;
 
         if constexpr(SPLIT_VALUE) {
-            impl::seek(m_fvalue, e.value.offset);
+            impl::seek(m_fvalue, e.offset);
 
             Serializer::deserialize(v, [&](void* data, size_t size) {
                 impl::read(m_fvalue, data, size);
@@ -561,7 +1163,7 @@ private:
         return true;
     }
 
-    size_t hash(K k) const {
+    uint64_t hash(K k) const {
         if constexpr(std::is_integral_v<K>) return k;
         else if constexpr(std::is_floating_point_v<K> || std::is_same_v<K, std::string>) return impl::fnv1a(k);
         else static_assert(impl::always_false_v<K>);
@@ -573,7 +1175,9 @@ private:
         kv_pair* h = this->get_kvpairs();
 
         for(size_t index = this->hash(k) % m_hash->capacity; ; index = (index + 1) % m_hash->capacity) {
-            if(h[index].state != STATE_FULL || h[index].key == k)
+            this->verify_slot(h + index);
+
+            if(h[index].state() != STATE_FULL || h[index].key == k)
                 return h[index];
         }
 
@@ -599,9 +1203,139 @@ private:
         assume(m_fhash != impl::INVALID_HANDLE);
 
         impl::resize(m_fhash, size);
-        m_hash = impl::mmap<hash_header>(m_fhash, size);
-        if(init) std::fill_n(reinterpret_cast<char*>(m_hash), size, 0);
+        m_hash = this->map_hashfile(size);
         assume(m_hash);
+        if(init) std::fill_n(reinterpret_cast<char*>(m_hash), size, 0);
+    }
+
+    uint32_t region_checksum(size_t r) const {
+        const size_t slotssize = m_hash->capacity * sizeof(kv_pair);
+        const char* p = reinterpret_cast<const char*>(this->get_kvpairs()) + (r * CHECKSUM_REGION);
+        return impl::crc32c(p, std::min(CHECKSUM_REGION, slotssize - (r * CHECKSUM_REGION)));
+    }
+
+    void verify_region(size_t r) const {
+        std::atomic<uint8_t>& state = m_regionstates[r];
+        uint8_t s = state.load(std::memory_order_acquire);
+        if(s == REGION_VERIFIED) return;
+
+        if(s == REGION_UNVERIFIED && state.compare_exchange_strong(s, REGION_VERIFYING, std::memory_order_acq_rel)) {
+            if(this->region_checksum(r) != m_checksums[r])
+                except("Checksum mismatch in '{}', region {}", m_fhashpath, r);
+
+            state.store(REGION_VERIFIED, std::memory_order_release);
+            return;
+        }
+
+        // Another thread is verifying it
+        while(state.load(std::memory_order_acquire) != REGION_VERIFIED)
+            std::this_thread::yield();
+    }
+
+    // A slot can straddle two regions
+    void verify_slot([[maybe_unused]] const kv_pair* e) const {
+        if constexpr(CHECKSUM) {
+            size_t offset = static_cast<size_t>(e - this->get_kvpairs()) * sizeof(kv_pair);
+            this->verify_region(offset / CHECKSUM_REGION);
+            this->verify_region((offset + sizeof(kv_pair) - 1) / CHECKSUM_REGION);
+        }
+    }
+
+    void touch_slot([[maybe_unused]] const kv_pair* e) {
+        if constexpr(CHECKSUM) {
+            size_t offset = static_cast<size_t>(e - this->get_kvpairs()) * sizeof(kv_pair);
+            m_dirtyregions[offset / CHECKSUM_REGION] = true;
+            m_dirtyregions[(offset + sizeof(kv_pair) - 1) / CHECKSUM_REGION] = true;
+            if(m_checksumclean) this->write_checksums(false);
+        }
+    }
+
+    // Trust the current contents: everything verified, everything to be recomputed
+    void reset_checksums() {
+        m_nregions = ((m_hash->capacity * sizeof(kv_pair)) + CHECKSUM_REGION - 1) / CHECKSUM_REGION;
+        m_checksums.assign(m_nregions, impl::le<uint32_t>{});
+        m_dirtyregions.assign(m_nregions, true);
+        m_regionstates.reset(new std::atomic<uint8_t>[m_nregions]);
+        for(size_t r = 0; r < m_nregions; ++r) m_regionstates[r].store(REGION_VERIFIED);
+        this->write_checksums(false);
+    }
+
+    void load_checksums(bool rebuild) {
+        m_fchecksumpath = m_fhashpath + impl::CHECKSUM_SUFFIX;
+
+        if(!impl::is_file(m_fchecksumpath)) {
+            if(!rebuild) except("Checksum file '{}' not found, load() with rebuildchecksums to trust '{}'", m_fchecksumpath, m_fhashpath);
+            SPDLOG_WARN("Checksum file '{}' not found, rebuilding it", m_fchecksumpath);
+            this->reset_checksums();
+            return;
+        }
+
+        impl::file_h h = impl::open(m_fchecksumpath);
+        checksum_header header;
+        impl::read(h, &header, sizeof(checksum_header));
+
+        if(header.signature != SIGNATURE || header.regionsize != CHECKSUM_REGION || header.capacity != m_hash->capacity) {
+            impl::close(h);
+            except("Checksum file '{}' doesn't match '{}'", m_fchecksumpath, m_fhashpath);
+        }
+
+        if(!header.clean) {
+            impl::close(h);
+            if(!rebuild) except("'{}' was not closed cleanly, load() with rebuildchecksums to trust it", m_fhashpath);
+            SPDLOG_WARN("'{}' was not closed cleanly, rebuilding checksums", m_fhashpath);
+            this->reset_checksums();
+            return;
+        }
+
+        m_nregions = ((m_hash->capacity * sizeof(kv_pair)) + CHECKSUM_REGION - 1) / CHECKSUM_REGION;
+        m_checksums.resize(m_nregions);
+        impl::read(h, m_checksums.data(), m_nregions * sizeof(impl::le<uint32_t>));
+        impl::close(h);
+
+        m_dirtyregions.assign(m_nregions, false);
+        m_regionstates.reset(new std::atomic<uint8_t>[m_nregions]);
+        for(size_t r = 0; r < m_nregions; ++r) m_regionstates[r].store(REGION_UNVERIFIED);
+        m_checksumclean = true;
+    }
+
+    void write_checksums(bool clean) {
+        assume(!m_fchecksumpath.empty());
+
+        checksum_header header;
+        header.signature = SIGNATURE;
+        header.regionsize = CHECKSUM_REGION;
+        header.capacity = m_hash->capacity;
+        header.clean = clean;
+
+        impl::file_h h = impl::open(m_fchecksumpath);
+        impl::resize(h, sizeof(checksum_header) + (m_nregions * sizeof(impl::le<uint32_t>)));
+        impl::write(h, &header, sizeof(checksum_header));
+        if(clean) impl::write(h, m_checksums.data(), m_nregions * sizeof(impl::le<uint32_t>));
+        impl::close(h);
+        m_checksumclean = clean;
+    }
+
+    hash_header* map_hashfile(size_t size) const {
+        // MAP_POPULATE would fault the table in before mbind(), under the
+        // default policy: with a NUMA policy populate through prefault()
+        constexpr bool NUMA = NUMA_POLICY != impl::numa_policy_default;
+        constexpr bool POPULATE = Flags & hashdb_flags_populate;
+
+        auto* h = impl::mmap<hash_header>(m_fhash, size, POPULATE && !NUMA);
+        if(!h) return nullptr;
+
+        const unsigned long mask = impl::numa_nodemask(NUMA_POLICY);
+
+        if constexpr(Flags & hashdb_flags_hugepage) impl::madvise_hugepage(h, size);
+        if constexpr(NUMA) impl::numa_mbind(h, size, NUMA_POLICY, mask);
+        if constexpr((Flags & hashdb_flags_warmup) || (POPULATE && NUMA)) impl::prefault(h, size, NUMA_POLICY, mask);
+
+        if constexpr(Flags & hashdb_flags_lock) {
+            if(!impl::mlock(h, size))
+                SPDLOG_WARN("Cannot lock '{}' in memory, check RLIMIT_MEMLOCK", m_fhashpath);
+        }
+
+        return h;
     }
 
     void reinit_valuefile(size_t capacity = DEFAULT_ITEMS_COUNT) {
@@ -614,8 +1348,19 @@ private:
 private:
     std::string m_fhashpath;
     std::string m_fvaluepath;
+    std::string m_fchecksumpath;
     std::string m_wbuffer;
+    std::string m_feedbuffer;
+    std::string m_feedrbuffer;
     impl::file_h m_fhash{impl::INVALID_HANDLE};
     impl::file_h m_fvalue{impl::INVALID_HANDLE};
+    impl::file_h m_ffeed{impl::INVALID_HANDLE};
+    size_t m_feedbatch{DEFAULT_FEED_BATCH};
+    uint32_t m_feedcount{0};
     hash_header* m_hash{nullptr};
+    std::vector<impl::le<uint32_t>> m_checksums;
+    std::vector<bool> m_dirtyregions;
+    mutable std::unique_ptr<std::atomic<uint8_t>[]> m_regionstates;
+    size_t m_nregions{0};
+    bool m_checksumclean{false};
 };
@@ -0,0 +1,364 @@
+// HashDB benchmark suite, results are printed as a single JSON document.
+// Every case runs with small POD values and with large split string values,
+// page cache sensitive cases run both warm and cold (POSIX_FADV_DONTNEED).
+//
+// Usage: hashdb_bench [items] [lookups] [directory]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include "hashdb.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Key = uint64_t;
+
+const std::string DB_NAME = "hashdb_bench";
+constexpr size_t STRING_VALUE_SIZE = 256;
+constexpr std::array<float, 4> LOAD_FACTORS = {0.25F, 0.5F, 0.625F, 0.75F};
+
+struct Options {
+    size_t items{size_t{1} << 22}; // Slot table well past any last-level cache
+    size_t lookups{size_t{1} << 20};
+    std::string directory{"/tmp"};
+};
+
+struct Result {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> fields;
+
+    Result& set(const std::string& k, const std::string& v) {
+        fields.emplace_back(k, fmt::format("\"{}\"", v));
+        return *this;
+    }
+
+    // Rates and latencies
+    Result& set(const std::string& k, double v) {
+        fields.emplace_back(k, fmt::format("{:.3f}", v));
+        return *this;
+    }
+
+    // Counts and sizes
+    Result& set(const std::string& k, size_t v) {
+        fields.emplace_back(k, fmt::format("{}", v));
+        return *this;
+    }
+};
+
+std::vector<Result> g_results;
+
+Result& report(const std::string& name) { return g_results.emplace_back(Result{name, {}}); }
+
+void print_report() {
+    fmt::print("{{\n  \"benchmarks\": [\n");
+
+    for(size_t i = 0; i < g_results.size(); ++i) {
+        const Result& r = g_results[i];
+        fmt::print("    {{\"name\": \"{}\"", r.name);
+        for(const auto& [k, v] : r.fields) fmt::print(", \"{}\": {}", k, v);
+        fmt::print("}}{}\n", i + 1 < g_results.size() ? "," : "");
+    }
+
+    fmt::print("  ]\n}}\n");
+}
+
+template<typename Function>
+double measure_ns(Function f) {
+    auto start = Clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+std::string base_path(const Options& o) { return o.directory + impl::PATH_SEPARATOR.data() + DB_NAME; }
+
+void drop_cache(const std::string& filepath) {
+    if(!impl::is_file(filepath)) return;
+
+    impl::file_h h = impl::open(filepath);
+    ::fdatasync(h);
+    ::posix_fadvise(h, 0, 0, POSIX_FADV_DONTNEED);
+    impl::close(h);
+}
+
+void drop_cache(const Options& o) {
+    drop_cache(base_path(o) + impl::HASH_SUFFIX);
+    drop_cache(base_path(o) + impl::VALUE_SUFFIX);
+}
+
+void remove_files(const Options& o) {
+    std::remove((base_path(o) + impl::HASH_SUFFIX).c_str());
+    std::remove((base_path(o) + impl::VALUE_SUFFIX).c_str());
+}
+
+std::vector<Key> random_keys(size_t n, uint64_t seed) {
+    std::mt19937_64 rng{seed};
+    std::vector<Key> keys(n);
+    for(Key& k : keys) k = rng();
+    return keys;
+}
+
+// Lookup keys picked at random among the inserted ones
+std::vector<Key> pick_keys(const std::vector<Key>& keys, size_t n, uint64_t seed) {
+    std::mt19937_64 rng{seed};
+    std::uniform_int_distribution<size_t> dist{0, keys.size() - 1};
+    std::vector<Key> picked(n);
+    for(Key& k : picked) k = keys[dist(rng)];
+    return picked;
+}
+
+template<typename V>
+struct ValueTraits;
+
+template<>
+struct ValueTraits<uint64_t> {
+    static constexpr const char* NAME = "pod";
+    static uint64_t make(Key k) { return k * 2; }
+    static size_t size(const uint64_t&) { return sizeof(uint64_t); }
+};
+
+template<>
+struct ValueTraits<std::string> {
+    static constexpr const char* NAME = "split_string";
+    static std::string make(Key k) { return std::string(STRING_VALUE_SIZE, static_cast<char>('a' + (k % 26))); }
+    static size_t size(const std::string& v) { return v.size(); }
+};
+
+template<typename V, typename DB>
+double lookup_ns(const DB& db, const std::vector<Key>& keys) {
+    size_t found = 0;
+
+    double ns = measure_ns([&]() {
+        for(Key k : keys) {
+            V v{};
+            found += db.get(k, v);
+        }
+    });
+
+    if(found > keys.size()) std::abort(); // Keep the loop alive
+    return ns / static_cast<double>(keys.size());
+}
+
+template<typename V>
+void bench_insert(const Options& o, const std::vector<Key>& keys) {
+    using Traits = ValueTraits<V>;
+
+    for(bool presize : {false, true}) {
+        HashDB<Key, V, hashdb_flags_remove> db{DB_NAME, o.directory};
+        if(presize) db.reserve(keys.size());
+
+        double ns = measure_ns([&]() {
+            for(Key k : keys) {
+                V v = Traits::make(k);
+                db.set(k, v);
+            }
+        });
+
+        report("insert")
+            .set("value", Traits::NAME)
+            .set("presize", presize ? "yes" : "no")
+            .set("items", keys.size())
+            .set("ops_per_sec", static_cast<double>(keys.size()) * 1e9 / ns)
+            .set("ns_per_op", ns / static_cast<double>(keys.size()));
+    }
+}
+
+template<typename V>
+void bench_lookup(const Options& o, const std::vector<Key>& keys) {
+    using Traits = ValueTraits<V>;
+
+    // Largest power of two capacity that 'keys' can fill up to the maximum load factor
+    size_t capacity = 4096;
+    while(static_cast<float>(capacity << 1) * LOAD_FACTORS.back() <= static_cast<float>(keys.size())) capacity <<= 1;
+
+    for(float lf : LOAD_FACTORS) {
+        size_t n = static_cast<size_t>(static_cast<float>(capacity) * lf);
+
+        {
+            HashDB<Key, V> db{DB_NAME, o.directory};
+            if(capacity > db.capacity()) db.rehash(capacity);
+
+            for(size_t i = 0; i < n; ++i) {
+                V v = Traits::make(keys[i]);
+                db.set(keys[i], v);
+            }
+        }
+
+        std::vector<Key> inserted{keys.begin(), keys.begin() + n};
+        std::vector<Key> hits = pick_keys(inserted, o.lookups, 1);
+        std::vector<Key> misses = random_keys(o.lookups, 2);
+
+        for(bool cold : {true, false}) {
+            if(cold) drop_cache(o);
+            auto db = HashDB<Key, V>::load(DB_NAME, o.directory);
+
+            // Cold misses run after the cold hits: report them warm only
+            double hitns = lookup_ns<V>(db, hits);
+            double missns = lookup_ns<V>(db, misses);
+
+            Result& r = report("lookup")
+                .set("value", Traits::NAME)
+                .set("cache", cold ? "cold" : "warm")
+                .set("load_factor", static_cast<double>(db.load_factor()))
+                .set("hit_ns", hitns);
+
+            if(!cold) r.set("miss_ns", missns);
+        }
+
+        remove_files(o);
+    }
+}
+
+template<typename V>
+void bench_churn(const Options& o, const std::vector<Key>& keys) {
+    using Traits = ValueTraits<V>;
+
+    HashDB<Key, V, hashdb_flags_remove> db{DB_NAME, o.directory};
+    db.reserve(keys.size());
+
+    size_t half = keys.size() / 2;
+    for(size_t i = 0; i < half; ++i) {
+        V v = Traits::make(keys[i]);
+        db.set(keys[i], v);
+    }
+
+    // Slide a window of 'half' live keys across the key set
+    double ns = measure_ns([&]() {
+        for(size_t i = half; i < keys.size(); ++i) {
+            db.erase(keys[i - half]);
+            V v = Traits::make(keys[i]);
+            db.set(keys[i], v);
+        }
+    });
+
+    double ops = static_cast<double>(2 * (keys.size() - half));
+
+    report("erase_churn")
+        .set("value", Traits::NAME)
+        .set("ops_per_sec", ops * 1e9 / ns)
+        .set("ns_per_op", ns / ops)
+        .set("capacity", db.capacity());
+}
+
+template<typename V>
+void bench_maintenance(const Options& o, const std::vector<Key>& keys) {
+    using Traits = ValueTraits<V>;
+
+    HashDB<Key, V, hashdb_flags_remove> db{DB_NAME, o.directory};
+    size_t valuebytes = 0;
+
+    for(Key k : keys) {
+        V v = Traits::make(k);
+        valuebytes += Traits::size(v);
+        db.set(k, v);
+    }
+
+    size_t capacity = db.capacity();
+    double rehashns = measure_ns([&]() { db.rehash(); });
+
+    report("rehash")
+        .set("value", Traits::NAME)
+        .set("from_capacity", capacity)
+        .set("pause_ms", rehashns / 1e6);
+
+    size_t n = 0;
+    double iterns = measure_ns([&]() {
+        for(auto it = db.begin(); it != db.end(); ++it) {
+            V v = it.value();
+            n += Traits::size(v);
+        }
+    });
+
+    report("iterate")
+        .set("value", Traits::NAME)
+        .set("items_per_sec", static_cast<double>(db.size()) * 1e9 / iterns)
+        .set("value_bytes", n);
+
+    if constexpr(std::is_same_v<V, std::string>) {
+        // Rewrite every other value with a bigger one: the old slots become garbage
+        for(size_t i = 0; i < keys.size(); i += 2) {
+            V v = Traits::make(keys[i]) + Traits::make(keys[i]);
+            valuebytes += Traits::size(v) / 2;
+            db.set(keys[i], v);
+        }
+
+        double gcns = measure_ns([&]() { db.collect_garbage(); });
+
+        report("collect_garbage")
+            .set("value", Traits::NAME)
+            .set("pause_ms", gcns / 1e6)
+            .set("mb_per_sec", static_cast<double>(valuebytes) * 1e3 / gcns);
+    }
+}
+
+template<size_t Flags>
+void bench_mapping(const char* name, const Options& o, const std::vector<Key>& keys) {
+    drop_cache(o);
+
+    auto start = Clock::now();
+    auto db = HashDB<Key, uint64_t, Flags>::load(DB_NAME, o.directory);
+    double loadns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    // First pass pays the page faults, the second one runs on a resident table
+    double coldns = lookup_ns<uint64_t>(db, keys);
+    double warmns = lookup_ns<uint64_t>(db, keys);
+
+    report("mapping")
+        .set("mapping", name)
+        .set("capacity", db.capacity())
+        .set("load_ms", loadns / 1e6)
+        .set("cold_lookup_ns", coldns)
+        .set("warm_lookup_ns", warmns);
+}
+
+void bench_mappings(const Options& o, const std::vector<Key>& keys) {
+    {
+        HashDB<Key, uint64_t> db{DB_NAME, o.directory};
+        db.reserve(keys.size());
+
+        for(Key k : keys) {
+            uint64_t v = ValueTraits<uint64_t>::make(k);
+            db.set(k, v);
+        }
+    }
+
+    std::vector<Key> lookups = pick_keys(keys, o.lookups, 3);
+    bench_mapping<hashdb_flags_none>("default", o, lookups);
+    bench_mapping<hashdb_flags_hugepage>("hugepage", o, lookups);
+    bench_mapping<hashdb_flags_populate>("populate", o, lookups);
+    bench_mapping<hashdb_flags_warmup>("warmup", o, lookups);
+    bench_mapping<hashdb_flags_hugepage | hashdb_flags_warmup | hashdb_flags_lock>("hugepage+warmup+lock", o, lookups);
+    bench_mapping<hashdb_flags_warmup | hashdb_flags_numa_interleave>("warmup+numa_interleave", o, lookups);
+    bench_mapping<hashdb_flags_warmup | hashdb_flags_numa_bind>("warmup+numa_bind", o, lookups);
+    remove_files(o);
+}
+
+template<typename V>
+void bench_value(const Options& o, const std::vector<Key>& keys) {
+    bench_insert<V>(o, keys);
+    bench_lookup<V>(o, keys);
+    bench_churn<V>(o, keys);
+    bench_maintenance<V>(o, keys);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    if(argc > 1) o.items = std::strtoull(argv[1], nullptr, 10);
+    if(argc > 2) o.lookups = std::strtoull(argv[2], nullptr, 10);
+    if(argc > 3) o.directory = argv[3];
+
+    std::vector<Key> keys = random_keys(o.items, 0x5d1b0239);
+
+    bench_value<uint64_t>(o, keys);
+    bench_value<std::string>(o, keys);
+    bench_mappings(o, keys);
+
+    print_report();
+    return 0;
+}
@@ -5,17 +5,23 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
 #include <limits>
 #include <map>
+#include <set>
 #include <string>
 #include <string_view>
 #include <sys/param.h>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -23,6 +29,64 @@
 #include <stdexcept>
 #endif
 
+#if __has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#define MSGPACK_IOVEC
+#endif
+
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define MSGPACK_PMR
+#endif
+
+#if __cplusplus >= 202002L
+#include <bit>
+#include <span>
+#endif
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <tmmintrin.h>
+#define MSGPACK_SSSE3_DISPATCH
+#endif
+
+#if !defined(MSGPACK_MAX_DEPTH)
+#define MSGPACK_MAX_DEPTH 512
+#endif
+
+// Default allocation budget of an unpacking MsgPack, in bytes
+#if !defined(MSGPACK_MAX_ALLOC)
+#define MSGPACK_MAX_ALLOC SIZE_MAX
+#endif
+
+#if defined(MSGPACK_NAMESPACE)
+#define MSGPACK_NS ::MSGPACK_NAMESPACE::msgpack
+#else
+#define MSGPACK_NS ::msgpack
+#endif
+
+// Struct reflection: list the members to encode, in order, inside the struct
+// body. MSGPACK_DEFINE encodes an array, MSGPACK_DEFINE_MAP a map keyed by
+// member names. Both generate the pack/unpack code at compile time
+#define MSGPACK_DEFINE_IMPL(asmap, ...)                                       \
+    static constexpr bool msgpack_map = asmap;                               \
+    static constexpr auto msgpack_names() {                                  \
+        return MSGPACK_NS::impl::field_names<MSGPACK_NS::impl::count_fields( \
+            #__VA_ARGS__)>(#__VA_ARGS__);                                    \
+    }                                                                        \
+    constexpr auto msgpack_fields() { return std::tie(__VA_ARGS__); }        \
+    constexpr auto msgpack_fields() const { return std::tie(__VA_ARGS__); }
+
+#define MSGPACK_DEFINE(...) MSGPACK_DEFINE_IMPL(false, __VA_ARGS__)
+#define MSGPACK_DEFINE_MAP(...) MSGPACK_DEFINE_IMPL(true, __VA_ARGS__)
+
 #if defined(__BYTE_ORDER)
 #if defined(__BIG_ENDIAN) && (__BYTE_ORDER == __BIG_ENDIAN)
 #define MSGPACK_BIG_ENDIAN
@@ -41,9 +105,81 @@ namespace MSGPACK_NAMESPACE {
 
 namespace msgpack {
 
+#if __cplusplus >= 202002L
+template<typename T>
+using Span = std::span<T>;
+#else
+// Minimal std::span replacement for C++17
+template<typename T>
+class Span {
+public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using iterator = T*;
+
+    constexpr Span() = default;
+    constexpr Span(T* data, size_t size): m_data{data}, m_size{size} {}
+
+    template<typename C, typename = std::enable_if_t<std::is_convertible_v<
+                             decltype(std::declval<C&>().data()), T*>>>
+    constexpr Span(C& c): m_data{c.data()}, m_size{c.size()} {} // NOLINT
+
+    [[nodiscard]] constexpr T* data() const { return m_data; }
+    [[nodiscard]] constexpr size_t size() const { return m_size; }
+    [[nodiscard]] constexpr bool empty() const { return !m_size; }
+    [[nodiscard]] constexpr T* begin() const { return m_data; }
+    [[nodiscard]] constexpr T* end() const { return m_data + m_size; }
+    constexpr T& operator[](size_t i) const { return m_data[i]; }
+
+    [[nodiscard]] constexpr Span subspan(size_t offset, size_t count) const {
+        return Span{m_data + offset, count};
+    }
+
+private:
+    T* m_data{nullptr};
+    size_t m_size{0};
+};
+#endif
+
+// Timestamp extension (type -1): seconds since the epoch plus nanoseconds
+struct Timestamp {
+    int64_t seconds{0};
+    uint32_t nanoseconds{0};
+
+    static Timestamp from(std::chrono::system_clock::time_point tp) {
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         tp.time_since_epoch())
+                         .count();
+
+        int64_t s = ns / 1000000000;
+        int64_t r = ns % 1000000000;
+
+        if(r < 0) { // Nanoseconds are never negative
+            --s;
+            r += 1000000000;
+        }
+
+        return {s, static_cast<uint32_t>(r)};
+    }
+
+    [[nodiscard]] std::chrono::system_clock::time_point time_point() const {
+        return std::chrono::system_clock::time_point{
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::seconds{seconds} +
+                std::chrono::nanoseconds{nanoseconds})};
+    }
+
+    bool operator==(const Timestamp& rhs) const {
+        return seconds == rhs.seconds && nanoseconds == rhs.nanoseconds;
+    }
+
+    bool operator!=(const Timestamp& rhs) const { return !(*this == rhs); }
+};
+
 template<typename Container>
 struct BasicVisitor {
     using ContainerType = Container;
+    using BinType = Span<const typename ContainerType::value_type>; // NOLINT
     using IntegerType = std::variant<int8_t, uint8_t, int16_t, uint16_t,
                                      int32_t, uint32_t, int64_t, uint64_t>;
 
@@ -61,11 +197,12 @@ struct BasicVisitor {
     bool visit_bool(bool /* arg */) { return true; }
     bool visit_str(std::string_view /* arg */) { return true; }
     bool visit_int(IntegerType /* arg */) { return true; }
-    bool visit_bin(const ContainerType& /* arg */) { return true; }
-
-    bool visit_ext(int8_t /*type*/, const ContainerType& /* arg */) {
-        return true;
-    }
+    bool visit_float(float /* arg */) { return true; }
+    bool visit_double(double /* arg */) { return true; }
+    bool visit_timestamp(Timestamp /* arg */) { return true; }
+    // Bin and ext payloads point into the decoded buffer
+    bool visit_bin(BinType /* arg */) { return true; }
+    bool visit_ext(int8_t /*type*/, BinType /* arg */) { return true; }
 };
 
 namespace impl {
@@ -85,6 +222,12 @@ inline constexpr bool is_array_v<std::vector<T, Allocator>> = true; // NOLINT
 template<typename T, std::size_t N>
 inline constexpr bool is_array_v<std::array<T, N>> = true; // NOLINT
 
+template<typename T>
+inline constexpr bool is_span_v = false; // NOLINT
+
+template<typename T>
+inline constexpr bool is_span_v<Span<T>> = true; // NOLINT
+
 template<typename T>
 inline constexpr bool is_vector_v = false; // NOLINT
 
@@ -98,16 +241,37 @@ template<typename K, typename V, typename Compare, typename Allocator>
 inline constexpr bool is_map_v<std::map<K, V, Compare, Allocator>> = // NOLINT
     true;
 
-template<typename K, typename V, typename Compare, typename Allocator>
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
 inline constexpr bool
-    is_map_v<std::unordered_map<K, V, Compare, Allocator>> = // NOLINT
+    is_map_v<std::unordered_map<K, V, Hash, KeyEqual, Allocator>> = // NOLINT
     true;
 
 template<typename T>
-inline constexpr bool is_string_v = false; // NOLINT
+inline constexpr bool is_set_v = false; // NOLINT
 
-template<>
-inline constexpr bool is_string_v<std::string> = true; // NOLINT
+template<typename K, typename Compare, typename Allocator>
+inline constexpr bool is_set_v<std::set<K, Compare, Allocator>> = true; // NOLINT
+
+template<typename K, typename Hash, typename KeyEqual, typename Allocator>
+inline constexpr bool // NOLINT
+    is_set_v<std::unordered_set<K, Hash, KeyEqual, Allocator>> = true;
+
+template<typename T, typename = void>
+inline constexpr bool is_unordered_v = false; // NOLINT
+
+template<typename T>
+inline constexpr bool is_unordered_v<T, std::void_t<typename T::hasher>> = // NOLINT
+    true;
+
+template<typename T>
+inline constexpr bool is_std_string_v = false; // NOLINT
+
+template<typename Traits, typename Allocator>
+inline constexpr bool // NOLINT
+    is_std_string_v<std::basic_string<char, Traits, Allocator>> = true;
+
+template<typename T>
+inline constexpr bool is_string_v = is_std_string_v<T>; // NOLINT
 
 template<>
 inline constexpr bool is_string_v<std::string_view> = true; // NOLINT
@@ -115,6 +279,223 @@ inline constexpr bool is_string_v<std::string_view> = true; // NOLINT
 template<>
 inline constexpr bool is_string_v<const char*> = true; // NOLINT
 
+template<typename T>
+inline constexpr bool is_tuple_v = false; // NOLINT
+
+template<typename... Args>
+inline constexpr bool is_tuple_v<std::tuple<Args...>> = true; // NOLINT
+
+template<typename T1, typename T2>
+inline constexpr bool is_tuple_v<std::pair<T1, T2>> = true; // NOLINT
+
+template<typename T, typename = void>
+inline constexpr bool is_reflected_v = false; // NOLINT
+
+template<typename T>
+inline constexpr bool // NOLINT
+    is_reflected_v<T, std::void_t<decltype(std::declval<const T&>().msgpack_fields())>> =
+        true;
+
+// Default constructed item built with 'alloc' when it takes one: pmr strings
+// and containers end up on their parent's memory resource
+template<typename T, typename Allocator>
+inline T make_item(const Allocator& alloc) {
+    if constexpr(std::uses_allocator_v<T, Allocator> &&
+                 std::is_constructible_v<T, const Allocator&>)
+        return T(alloc);
+    else
+        return T();
+}
+
+// Member name list from MSGPACK_DEFINE*()'s stringified arguments
+constexpr size_t count_fields(std::string_view s) {
+    size_t n = 1;
+    for(char c : s)
+        n += c == ',';
+    return n;
+}
+
+template<size_t N>
+constexpr std::array<std::string_view, N> field_names(std::string_view s) {
+    std::array<std::string_view, N> names{};
+
+    for(size_t i = 0; i < N; ++i) {
+        size_t comma = s.find(',');
+        std::string_view name = s.substr(0, comma);
+
+        while(!name.empty() && name.front() == ' ')
+            name.remove_prefix(1);
+        while(!name.empty() && name.back() == ' ')
+            name.remove_suffix(1);
+
+        names[i] = name;
+        s = comma == std::string_view::npos ? std::string_view{}
+                                            : s.substr(comma + 1);
+    }
+
+    return names;
+}
+
+// Perfect hash of a member name list, built at compile time: every name owns
+// a slot, so a key lookup is one hash, one load and one compare. The hash
+// only mixes the length with the first and the last two bytes when that
+// tells the names apart, the whole key otherwise
+template<size_t N, size_t Bits>
+struct KeyTable {
+    static constexpr size_t NPOS = N;
+
+    uint64_t seed{};
+    bool full{};
+    std::array<uint16_t, size_t{1} << Bits> slots{};
+    std::array<std::string_view, N> names{};
+
+    static constexpr uint64_t hash(std::string_view k, uint64_t seed, bool full) {
+        uint64_t h = seed ^ k.size();
+
+        if(full) {
+            for(char c : k)
+                h = (h ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+        }
+        else if(!k.empty()) {
+            auto byte = [&](size_t i) {
+                return static_cast<uint64_t>(static_cast<uint8_t>(k[i]));
+            };
+            h ^= byte(0) << 32 | byte(k.size() - 1) << 24 |
+                 (k.size() > 1 ? byte(k.size() - 2) << 16 : 0);
+        }
+
+        return (h * 0x9E3779B97F4A7C15ULL) >> (64 - Bits);
+    }
+
+    // The only member 'key' can be, still to be compared: NPOS or any index
+    [[nodiscard]] constexpr size_t candidate(std::string_view key) const {
+        return slots[KeyTable::hash(key, seed, full)];
+    }
+
+    // Member index of 'key', NPOS when unknown
+    [[nodiscard]] constexpr size_t find(std::string_view key) const {
+        size_t i = this->candidate(key);
+        return i < N && names[i] == key ? i : NPOS;
+    }
+};
+
+inline constexpr size_t KEY_TABLE_SEEDS = 256;
+inline constexpr size_t KEY_TABLE_MAX_BITS = 16;
+
+// Slots 'names' into a table of 1 << Bits entries, 'seed' is set to
+// KEY_TABLE_SEEDS when no seed tried works
+template<size_t Bits, size_t N>
+constexpr KeyTable<N, Bits>
+make_key_table(const std::array<std::string_view, N>& names) {
+    KeyTable<N, Bits> t{};
+    t.names = names;
+
+    for(bool full : {false, true}) {
+        for(uint64_t seed = 0; seed < KEY_TABLE_SEEDS; ++seed) {
+            bool ok = true;
+            for(uint16_t& s : t.slots)
+                s = static_cast<uint16_t>(N);
+
+            for(size_t i = 0; ok && i < N; ++i) {
+                uint16_t& s = t.slots[KeyTable<N, Bits>::hash(names[i], seed, full)];
+                ok = s == N;
+                s = static_cast<uint16_t>(i);
+            }
+
+            if(ok) {
+                t.seed = seed;
+                t.full = full;
+                return t;
+            }
+        }
+    }
+
+    t.seed = KEY_TABLE_SEEDS;
+    return t;
+}
+
+// Smallest table, twice the names at least, where a perfect hash was found
+template<size_t Bits = 1, size_t N>
+constexpr size_t key_table_bits(const std::array<std::string_view, N>& names) {
+    if constexpr(Bits >= KEY_TABLE_MAX_BITS)
+        return Bits;
+    else if constexpr((size_t{1} << Bits) < 2 * N)
+        return impl::key_table_bits<Bits + 1>(names);
+    else {
+        if(impl::make_key_table<Bits>(names).seed < KEY_TABLE_SEEDS)
+            return Bits;
+        return impl::key_table_bits<Bits + 1>(names);
+    }
+}
+
+template<typename T>
+inline constexpr auto key_table_v = [] { // NOLINT
+    constexpr auto names = T::msgpack_names();
+    constexpr auto table = impl::make_key_table<impl::key_table_bits(names)>(names);
+    static_assert(table.seed < KEY_TABLE_SEEDS,
+                  "MsgPack: No perfect hash for the member names");
+    return table;
+}();
+
+constexpr size_t aggregate_bound(size_t n) {
+    return n <= 0xF ? 1 : (n <= std::numeric_limits<uint16_t>::max() ? 3 : 5);
+}
+
+constexpr size_t string_bound(size_t n) {
+    if(n <= 31)
+        return n + 1;
+    if(n <= std::numeric_limits<uint8_t>::max())
+        return n + 2;
+    return n + (n <= std::numeric_limits<uint16_t>::max() ? 3 : 5);
+}
+
+template<typename T>
+constexpr size_t packed_bound();
+
+template<typename Tuple, size_t... I>
+constexpr size_t tuple_bound(std::index_sequence<I...>) {
+    if(((impl::packed_bound<std::decay_t<std::tuple_element_t<I, Tuple>>>() == 0) || ...))
+        return 0;
+    return (impl::packed_bound<std::decay_t<std::tuple_element_t<I, Tuple>>>() + ... + 0);
+}
+
+// Largest encoded size when every member has a fixed width, 0 otherwise
+template<typename T>
+constexpr size_t packed_bound() {
+    if constexpr(is_bool_v<T> || std::is_null_pointer_v<T>)
+        return 1;
+    else if constexpr(std::is_same_v<T, float> || std::is_same_v<T, double>)
+        return sizeof(T) + 1;
+    else if constexpr(std::is_same_v<T, Timestamp>)
+        return 15; // Timestamp 96 as ext8
+    else if constexpr(std::is_enum_v<T>)
+        return impl::packed_bound<std::underlying_type_t<T>>();
+    else if constexpr(std::is_integral_v<T>)
+        return sizeof(T) + 1;
+    else if constexpr(is_tuple_v<T>) {
+        constexpr size_t n = std::tuple_size_v<T>;
+        constexpr size_t items = impl::tuple_bound<T>(std::make_index_sequence<n>{});
+        return items || !n ? impl::aggregate_bound(n) + items : 0;
+    }
+    else if constexpr(is_reflected_v<T>) {
+        using Fields = decltype(std::declval<const T&>().msgpack_fields());
+        constexpr size_t n = std::tuple_size_v<Fields>;
+        constexpr size_t items = impl::tuple_bound<Fields>(std::make_index_sequence<n>{});
+        if(!items)
+            return 0;
+
+        size_t keys = 0;
+        if constexpr(T::msgpack_map) {
+            for(std::string_view name : T::msgpack_names())
+                keys += impl::string_bound(name.size());
+        }
+
+        return impl::aggregate_bound(n) + keys + items;
+    }
+    else
+        return 0;
+}
+
 struct Format {
     using Type = uint8_t;
 
@@ -131,6 +512,8 @@ struct Format {
         EXT8 = 0xc7,
         EXT16 = 0xc8,
         EXT32 = 0xc9,
+        FLOAT32 = 0xca,
+        FLOAT64 = 0xcb,
         UINT8 = 0xcc,
         UINT16 = 0xcd,
         UINT32 = 0xce,
@@ -164,244 +547,910 @@ struct Format {
 #endif
 }
 
-template<typename T>
-T swap_bigendian(T t) {
-#if defined(MSGPACK_LITTLE_ENDIAN)
-    union {
-        T u;
-        uint8_t b[sizeof(T)]; // NOLINT
-    } source{t}, dest;
+inline constexpr int8_t TIMESTAMP_TYPE = -1;
 
-    for(size_t i = 0; i < sizeof(T); i++)
-        dest.b[i] = source.b[sizeof(T) - i - 1];
+template<typename T>
+inline T byteswap(T t) {
+    static_assert(std::is_integral_v<T>);
 
-    return dest.u;
+#if defined(__cpp_lib_byteswap)
+    return std::byteswap(t);
 #else
+    using U = std::make_unsigned_t<T>;
+    auto u = static_cast<U>(t);
+
+    if constexpr(sizeof(T) == sizeof(uint8_t))
         return t;
+#if defined(_MSC_VER) && !defined(__clang__)
+    else if constexpr(sizeof(T) == sizeof(uint16_t))
+        u = _byteswap_ushort(u);
+    else if constexpr(sizeof(T) == sizeof(uint32_t))
+        u = _byteswap_ulong(u);
+    else if constexpr(sizeof(T) == sizeof(uint64_t))
+        u = _byteswap_uint64(u);
+#else
+    else if constexpr(sizeof(T) == sizeof(uint16_t))
+        u = __builtin_bswap16(u);
+    else if constexpr(sizeof(T) == sizeof(uint32_t))
+        u = __builtin_bswap32(u);
+    else if constexpr(sizeof(T) == sizeof(uint64_t))
+        u = __builtin_bswap64(u);
+#endif
+    else
+        static_assert(impl::always_false_v<T>, "byteswap(): Unsupported size");
+
+    return static_cast<T>(u);
 #endif
 }
 
-template<typename T, typename MsgPackType>
-bool visit_type(MsgPackType& mp, T& t) {
-    if(mp.at_end())
-        return false;
-    mp.unpack(t);
-    return true;
+template<typename T>
+inline T swap_bigendian(T t) {
+#if defined(MSGPACK_LITTLE_ENDIAN)
+    return impl::byteswap(t);
+#else
+    return t;
+#endif
 }
 
-template<typename MsgPackType, typename VisitorType>
-bool visit(MsgPackType& mp, VisitorType&& visitor);
+// Unaligned big endian store, the counterpart of load_bigendian()
+template<typename T>
+inline void store_bigendian(uint8_t* p, T t) {
+    t = impl::swap_bigendian(t);
+    std::memcpy(p, &t, sizeof(T));
+}
 
-template<typename MsgPackType, typename VisitorType>
-bool visit_bin(MsgPackType& mp, VisitorType&& visitor) {
-    if(mp.at_end())
-        return false;
-    auto c = mp.unpack_bin();
-    return visitor.visit_bin(c);
+// Timestamp 32, 64 and 96 payloads, false for any other size
+inline bool decode_timestamp(const uint8_t* p, size_t size, Timestamp& ts) {
+    switch(size) {
+        case 4: {
+            uint32_t s;
+            std::memcpy(&s, p, sizeof(s));
+            ts = {impl::swap_bigendian(s), 0};
+            return true;
+        }
+
+        case 8: { // 30 bits of nanoseconds, 34 bits of seconds
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            v = impl::swap_bigendian(v);
+            ts = {static_cast<int64_t>(v & 0x3FFFFFFFFULL),
+                  static_cast<uint32_t>(v >> 34)};
+            return true;
+        }
+
+        case 12: {
+            uint32_t ns;
+            int64_t s;
+            std::memcpy(&ns, p, sizeof(ns));
+            std::memcpy(&s, p + sizeof(ns), sizeof(s));
+            ts = {impl::swap_bigendian(s), impl::swap_bigendian(ns)};
+            return true;
+        }
+
+        default: break;
+    }
+
+    return false;
 }
 
-template<typename MsgPackType, typename VisitorType>
-bool visit_ext(MsgPackType& mp, VisitorType&& visitor) {
-    if(mp.at_end())
-        return false;
-    auto [type, ext] = mp.unpack_ext();
-    return visitor.visit_ext(type, ext);
+// Byte swaps 'n' doubles into big endian order
+inline void swap_doubles(uint64_t* dst, const double* src, size_t n) {
+    for(size_t i = 0; i < n; ++i) {
+        std::memcpy(dst + i, src + i, sizeof(uint64_t));
+        dst[i] = impl::swap_bigendian(dst[i]);
+    }
 }
 
-template<typename MsgPackType, typename VisitorType>
-bool visit_array(MsgPackType& mp, VisitorType&& visitor) {
-    if(mp.at_end())
-        return false;
+#if defined(MSGPACK_SSSE3_DISPATCH) && defined(MSGPACK_LITTLE_ENDIAN)
+__attribute__((target("ssse3"))) inline void
+swap_doubles_ssse3(uint64_t* dst, const double* src, size_t n) {
+    const __m128i mask =
+        _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    size_t i = 0;
+
+    for(; i + 2 <= n; i += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         _mm_shuffle_epi8(v, mask));
+    }
 
-    size_t s = mp.unpack_array();
-    if(!visitor.start_array(s))
-        return false;
+    impl::swap_doubles(dst + i, src + i, n - i);
+}
+#endif
 
-    for(size_t i = 0; i < s; ++i) {
-        if(!visitor.start_array_item(i) ||
-           !impl::visit(mp, std::forward<VisitorType>(visitor)) ||
-           !visitor.end_array_item(i))
-            return false;
+inline void swap_doubles_bulk(uint64_t* dst, const double* src, size_t n) {
+#if defined(MSGPACK_SSSE3_DISPATCH) && defined(MSGPACK_LITTLE_ENDIAN)
+    static const bool SSSE3 = __builtin_cpu_supports("ssse3");
+    if(SSSE3)
+        return impl::swap_doubles_ssse3(dst, src, n);
+#endif
+    impl::swap_doubles(dst, src, n);
+}
+
+// Element header decoded from the format byte and its length fields
+struct Header {
+    enum Kind : uint8_t {
+        NIL = 0,
+        BOOL,
+        UINT,
+        INT,
+        FLOAT, // Raw IEEE 754 bits, the header size tells the width
+        STR,
+        BIN,
+        EXT,
+        ARRAY,
+        MAP,
+        INVALID, // Reserved format byte (0xc1)
+    };
+
+    Kind kind;
+    uint8_t size;   // Header bytes: format, length field and ext type
+    uint64_t value; // Fixnum/bool value, payload bytes or item count
+    int8_t type;    // Ext type
+};
+
+template<typename T>
+inline T load_bigendian(const uint8_t* p) {
+    T t;
+    std::memcpy(&t, p, sizeof(T));
+    return impl::swap_bigendian(t);
+}
+
+// Per format byte: the element kind and how its header is laid out. Every
+// decode path classifies a format byte with one load from FORMATS
+struct FormatDesc {
+    Header::Kind kind;
+    uint8_t size;  // Header bytes: format, length field and ext type
+    uint8_t width; // Big endian length, count or scalar field past the format
+    int8_t fixed;  // Value, count or payload length held by the format itself
+};
+
+inline constexpr std::array<FormatDesc, 256> FORMATS = [] {
+    std::array<FormatDesc, 256> t{};
+
+    for(size_t f = 0; f < 0x100; ++f) {
+        auto v = static_cast<int8_t>(f);
+
+        if(f <= 0x7f)
+            t[f] = {Header::UINT, 1, 0, v};
+        else if(f <= 0x8f)
+            t[f] = {Header::MAP, 1, 0, static_cast<int8_t>(f & 0x0F)};
+        else if(f <= 0x9f)
+            t[f] = {Header::ARRAY, 1, 0, static_cast<int8_t>(f & 0x0F)};
+        else if(f <= 0xbf)
+            t[f] = {Header::STR, 1, 0, static_cast<int8_t>(f & 0x1F)};
+        else if(f >= 0xe0)
+            t[f] = {Header::INT, 1, 0, v};
+        else
+            t[f] = {Header::INVALID, 1, 0, 0};
+    }
+
+    t[Format::NIL] = {Header::NIL, 1, 0, 0};
+    t[Format::FALSE] = {Header::BOOL, 1, 0, 0};
+    t[Format::TRUE] = {Header::BOOL, 1, 0, 1};
+
+    t[Format::UINT8] = {Header::UINT, 2, 1, 0};
+    t[Format::UINT16] = {Header::UINT, 3, 2, 0};
+    t[Format::UINT32] = {Header::UINT, 5, 4, 0};
+    t[Format::UINT64] = {Header::UINT, 9, 8, 0};
+    t[Format::INT8] = {Header::INT, 2, 1, 0};
+    t[Format::INT16] = {Header::INT, 3, 2, 0};
+    t[Format::INT32] = {Header::INT, 5, 4, 0};
+    t[Format::INT64] = {Header::INT, 9, 8, 0};
+    t[Format::FLOAT32] = {Header::FLOAT, 5, 4, 0};
+    t[Format::FLOAT64] = {Header::FLOAT, 9, 8, 0};
+
+    t[Format::STR8] = {Header::STR, 2, 1, 0};
+    t[Format::STR16] = {Header::STR, 3, 2, 0};
+    t[Format::STR32] = {Header::STR, 5, 4, 0};
+    t[Format::BIN8] = {Header::BIN, 2, 1, 0};
+    t[Format::BIN16] = {Header::BIN, 3, 2, 0};
+    t[Format::BIN32] = {Header::BIN, 5, 4, 0};
+    t[Format::ARRAY16] = {Header::ARRAY, 3, 2, 0};
+    t[Format::ARRAY32] = {Header::ARRAY, 5, 4, 0};
+    t[Format::MAP16] = {Header::MAP, 3, 2, 0};
+    t[Format::MAP32] = {Header::MAP, 5, 4, 0};
+
+    t[Format::FIXEXT1] = {Header::EXT, 2, 0, 1};
+    t[Format::FIXEXT2] = {Header::EXT, 2, 0, 2};
+    t[Format::FIXEXT4] = {Header::EXT, 2, 0, 4};
+    t[Format::FIXEXT8] = {Header::EXT, 2, 0, 8};
+    t[Format::FIXEXT16] = {Header::EXT, 2, 0, 16};
+    t[Format::EXT8] = {Header::EXT, 3, 1, 0};
+    t[Format::EXT16] = {Header::EXT, 4, 2, 0};
+    t[Format::EXT32] = {Header::EXT, 6, 4, 0};
+    return t;
+}();
+
+// Header value of the element at 'p', its d.size bytes available. Fixed
+// values are sign extended, so negative fixints read as int64_t
+inline uint64_t format_value(const FormatDesc& d, const uint8_t* p) {
+    switch(d.width) {
+        case 1: return p[1];
+        case 2: return impl::load_bigendian<uint16_t>(p + 1);
+        case 4: return impl::load_bigendian<uint32_t>(p + 1);
+        case 8: return impl::load_bigendian<uint64_t>(p + 1);
+        default: break;
     }
 
-    return visitor.end_array();
+    return static_cast<uint64_t>(static_cast<int64_t>(d.fixed));
 }
 
-template<typename MsgPackType, typename VisitorType>
-bool visit_map(MsgPackType& mp, VisitorType&& visitor) {
-    if(mp.at_end())
+// Returns false when 'avail' bytes are not enough for the header, scalar
+// payloads included. Never throws: invalid format bytes yield Header::INVALID
+inline bool parse_header(const uint8_t* p, size_t avail, Header& h) {
+    if(!avail)
         return false;
 
-    size_t s = mp.unpack_map();
-    if(!visitor.start_map(s))
+    const FormatDesc& d = FORMATS[p[0]];
+    h.kind = d.kind;
+    h.size = d.size;
+    h.type = 0;
+
+    if(avail < d.size)
         return false;
 
-    for(size_t i = 0; i < s; ++i) {
-        if(!visitor.start_map_key(i) ||
-           !impl::visit(mp, std::forward<VisitorType>(visitor)) ||
-           !visitor.end_map_key(i))
-            return false;
-        if(!visitor.start_map_value(i) ||
-           !impl::visit(mp, std::forward<VisitorType>(visitor)) ||
-           !visitor.end_map_value(i))
-            return false;
+    h.value = impl::format_value(d, p);
+    if(d.kind == Header::EXT)
+        h.type = static_cast<int8_t>(p[d.size - 1]);
+    return true;
+}
+
+// Raw FLOAT header bits as float or double
+template<typename T>
+T header_float(const Header& h) {
+    using Bits = std::conditional_t<sizeof(T) == sizeof(uint32_t), uint32_t, uint64_t>;
+
+    auto bits = static_cast<Bits>(h.value);
+    T t;
+    std::memcpy(&t, &bits, sizeof(T));
+    return t;
+}
+
+// Fixnums and sized integers as the narrowest matching IntegerType alternative
+template<typename IntegerType>
+IntegerType header_integer(const Header& h, uint8_t width) {
+    if(h.kind == Header::UINT) {
+        switch(width) {
+            case 2: return static_cast<uint16_t>(h.value);
+            case 4: return static_cast<uint32_t>(h.value);
+            case 8: return static_cast<uint64_t>(h.value);
+            default: return static_cast<uint8_t>(h.value);
+        }
     }
 
-    return visitor.end_map();
+    switch(width) {
+        case 2: return static_cast<int16_t>(h.value);
+        case 4: return static_cast<int32_t>(h.value);
+        case 8: return static_cast<int64_t>(h.value);
+        default: return static_cast<int8_t>(h.value);
+    }
 }
 
+// Iterative visit of the element at mp.pos. Open containers live on a fixed
+// stack of MSGPACK_MAX_DEPTH frames rather than on the call stack, nesting
+// past 'maxdepth' throws. False at the end of the buffer or when the visitor
+// stops, mp.pos is left past the last element consumed
 template<typename MsgPackType, typename VisitorType>
-bool visit(MsgPackType& mp, VisitorType&& visitor) {
-    if(mp.at_end())
-        return false;
+bool visit(MsgPackType& mp, VisitorType& visitor, size_t maxdepth) {
+    using ValueType = typename MsgPackType::ValueType;
+    using IntegerType = typename std::decay_t<VisitorType>::IntegerType;
+
+    struct Frame {
+        uint32_t size;
+        uint32_t index;
+        bool map;
+        bool value; // Map only: the current slot is a value
+    };
 
-    auto f = static_cast<uint8_t>(mp.buffer.get()[mp.pos]);
+    std::array<Frame, MSGPACK_MAX_DEPTH> stack;
+    size_t depth = 0;
+    maxdepth = std::min<size_t>(maxdepth, MSGPACK_MAX_DEPTH);
 
-    if((f & 0xF0) == impl::Format::FIXMAP)
-        return impl::visit_map(mp, visitor);
-    if((f & 0xF0) == impl::Format::FIXARRAY)
-        return impl::visit_array(mp, visitor);
-    if((f & 0xE0) == impl::Format::FIXSTR) {
-        std::string_view v;
-        return impl::visit_type(mp, v) && visitor.visit_str(v);
-    }
+    const auto* const begin =
+        reinterpret_cast<const uint8_t*>(mp.buffer.get().data());
+    const uint8_t* const end = begin + mp.buffer.get().size();
+    const uint8_t* p = begin + mp.pos;
+
+    auto done = [&](bool ok) {
+        mp.pos = static_cast<size_t>(p - begin);
+        return ok;
+    };
+
+    if(p == end)
+        return false;
 
-    switch(f) {
-        case impl::Format::MAP16:
-        case impl::Format::MAP32: return impl::visit_map(mp, visitor);
+    for(;;) {
+        Header h;
+        if(!impl::parse_header(p, static_cast<size_t>(end - p), h))
+            impl::msgpack_except("msgpack::visit(): Reached EOB");
+
+        uint64_t payload = 0;
+        if(h.kind == Header::STR || h.kind == Header::BIN || h.kind == Header::EXT)
+            payload = h.value;
+        if(payload > static_cast<uint64_t>(end - p) - h.size)
+            impl::msgpack_except("msgpack::visit(): Reached EOB");
+
+        const uint8_t* body = p + h.size;
+        p = body + payload;
+        bool ok = true;
+
+        switch(h.kind) {
+            case Header::NIL: ok = visitor.visit_nil(); break;
+            case Header::BOOL: ok = visitor.visit_bool(h.value != 0); break;
+
+            case Header::UINT:
+            case Header::INT:
+                ok = visitor.visit_int(impl::header_integer<IntegerType>(
+                    h, static_cast<uint8_t>(h.size - 1)));
+                break;
 
-        case impl::Format::ARRAY16:
-        case impl::Format::ARRAY32: return impl::visit_array(mp, visitor);
+            case Header::FLOAT:
+                if(h.size == sizeof(float) + 1)
+                    ok = visitor.visit_float(impl::header_float<float>(h));
+                else
+                    ok = visitor.visit_double(impl::header_float<double>(h));
+                break;
 
-        case impl::Format::FIXEXT1:
-        case impl::Format::FIXEXT2:
-        case impl::Format::FIXEXT4:
-        case impl::Format::FIXEXT8:
-        case impl::Format::EXT8:
-        case impl::Format::EXT16:
-        case impl::Format::EXT32: return impl::visit_ext(mp, visitor);
+            case Header::STR:
+                ok = visitor.visit_str(std::string_view{
+                    reinterpret_cast<const char*>(body), h.value});
+                break;
 
-        case impl::Format::BIN8:
-        case impl::Format::BIN16:
-        case impl::Format::BIN32: return impl::visit_bin(mp, visitor);
+            case Header::BIN:
+                ok = visitor.visit_bin(
+                    Span<const ValueType>{reinterpret_cast<const ValueType*>(body),
+                                          static_cast<size_t>(h.value)});
+                break;
 
-        case impl::Format::STR8:
-        case impl::Format::STR16:
-        case impl::Format::STR32: {
-            std::string_view v;
-            return impl::visit_type(mp, v) && visitor.visit_str(v);
-        }
+            case Header::EXT: {
+                if(h.type == impl::TIMESTAMP_TYPE) {
+                    Timestamp ts;
+                    if(!impl::decode_timestamp(body, h.value, ts))
+                        impl::msgpack_except("msgpack::visit(): Invalid timestamp");
+                    ok = visitor.visit_timestamp(ts);
+                    break;
+                }
 
-        case impl::Format::UINT8: {
-            uint8_t v;
-            return impl::visit_type(mp, v) && visitor.visit_int(v);
-        }
-        case impl::Format::UINT16: {
-            uint16_t v;
-            return impl::visit_type(mp, v) && visitor.visit_int(v);
-        }
-        case impl::Format::UINT32: {
-            uint32_t v;
-            return impl::visit_type(mp, v) && visitor.visit_int(v);
-        }
-        case impl::Format::UINT64: {
-            uint64_t v;
-            return impl::visit_type(mp, v) && visitor.visit_int(v);
-        }
-        case impl::Format::INT8: {
-            int8_t v;
-            return impl::visit_type(mp, v) && visitor.visit_int(v);
-        }
-        case impl::Format::INT16: {
-            int16_t v;
-            return impl::visit_type(mp, v) && visitor.visit_int(v);
-        }
-        case impl::Format::INT32: {
-            int32_t v;
-            return impl::visit_type(mp, v) && visitor.visit_int(v);
-        }
-        case impl::Format::INT64: {
-            int64_t v;
-            return impl::visit_type(mp, v) && visitor.visit_int(v);
-        }
-        case impl::Format::TRUE: {
-            ++mp.pos;
-            return visitor.visit_bool(true);
-        }
-        case impl::Format::FALSE: {
-            ++mp.pos;
-            return visitor.visit_bool(false);
-        }
-        case impl::Format::NIL: {
-            ++mp.pos;
-            return visitor.visit_nil();
-        }
+                ok = visitor.visit_ext(
+                    h.type,
+                    Span<const ValueType>{reinterpret_cast<const ValueType*>(body),
+                                          static_cast<size_t>(h.value)});
+                break;
+            }
 
-        default: {
-            ++mp.pos;
-            int sel = static_cast<int>(f);
+            case Header::ARRAY:
+            case Header::MAP: {
+                const bool map = h.kind == Header::MAP;
+                if(depth >= maxdepth)
+                    impl::msgpack_except("msgpack::visit(): Maximum depth exceeded");
+                if(!(map ? visitor.start_map(h.value) : visitor.start_array(h.value)))
+                    return done(false);
+
+                if(!h.value) {
+                    ok = map ? visitor.end_map() : visitor.end_array();
+                    break;
+                }
 
-            if(sel >= 0x00 && sel <= 0x7F) // Positive FIXNUM
-                return visitor.visit_int(static_cast<uint8_t>(f));
-            if(sel >= 0xe0 && sel <= 0xFF) // Negative FIXNUM
-                return visitor.visit_int(static_cast<int8_t>(f));
+                stack[depth++] = {static_cast<uint32_t>(h.value), 0, map, false};
+                if(!(map ? visitor.start_map_key(0) : visitor.start_array_item(0)))
+                    return done(false);
+                continue;
+            }
 
-            impl::msgpack_except("msgpack::visit(): Invalid Format");
-            break;
+            default: impl::msgpack_except("msgpack::visit(): Invalid Format");
         }
-    }
 
-    return false;
-}
+        if(!ok)
+            return done(false);
 
-} // namespace impl
+        // Close the slots, and the containers, the element just completed
+        while(depth) {
+            Frame& f = stack[depth - 1];
+            const size_t i = f.index;
 
-template<typename Container>
-struct BasicMsgPack {
-    using Type = BasicMsgPack<Container>;
-    using ContainerType = Container;
-    using ValueType = typename ContainerType::value_type;
+            if(f.map && !f.value) {
+                f.value = true;
+                if(!visitor.end_map_key(i) || !visitor.start_map_value(i))
+                    return done(false);
+                break;
+            }
 
-    static_assert(sizeof(ValueType) == sizeof(uint8_t));
+            if(!(f.map ? visitor.end_map_value(i) : visitor.end_array_item(i)))
+                return done(false);
 
-    explicit BasicMsgPack() = delete;
-    explicit BasicMsgPack(ContainerType& c): buffer{c} {}
-    explicit BasicMsgPack(const ContainerType& c)
-        : buffer{const_cast<ContainerType&>(c)}, m_readonly{true} {}
+            f.value = false;
+            if(++f.index < f.size) {
+                ok = f.map ? visitor.start_map_key(f.index)
+                           : visitor.start_array_item(f.index);
+                if(!ok)
+                    return done(false);
+                break;
+            }
 
-    [[nodiscard]] inline size_t size() const { return this->buffer().size(); }
-    inline void rewind() { this->pos = 0; }
+            --depth;
+            if(!(f.map ? visitor.end_map() : visitor.end_array()))
+                return done(false);
+        }
 
-    inline void push(const ContainerType& c) {
-        std::copy(c.cbegin(), c.cend(), std::back_inserter(this->buffer.get()));
+        if(!depth)
+            return done(true);
     }
+}
 
-    [[nodiscard]] inline bool at_end() const {
-        return this->pos >= this->buffer.get().size();
+// Length of the fixint run at 'p', 'n' bytes at most: positive and negative
+// fixints together are exactly the bytes that are >= -32 as int8_t
+inline size_t fixint_run(const uint8_t* p, size_t n) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i lower = _mm_set1_epi8(-33);
+
+    for(; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        auto mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(v, lower)));
+
+        if(mask != 0xFFFF)
+            return i + static_cast<size_t>(__builtin_ctz(~mask));
     }
+#endif
 
-    Type& pack_bin(const ValueType* data, size_t size) {
-        assert(data);
+    while(i < n && static_cast<int8_t>(p[i]) >= -32)
+        ++i;
+    return i;
+}
 
-        if(size <= std::numeric_limits<std::uint8_t>::max()) {
-            this->pack_format(impl::Format::BIN8);
-            this->pack_int(static_cast<uint8_t>(size));
-        }
-        else if(size <= std::numeric_limits<std::uint16_t>::max()) {
-            this->pack_format(impl::Format::BIN16);
-            this->pack_int(static_cast<uint16_t>(size));
-        }
-        else {
-            this->pack_format(impl::Format::BIN32);
-            this->pack_int(static_cast<uint32_t>(size));
+// Skips up to 'max' fixints and fixstrs without a full header decode, stops
+// at anything else (truncated strings included)
+inline uint64_t skip_leaves(const uint8_t*& p, const uint8_t* end,
+                            uint64_t max) {
+    uint64_t n = 0;
+
+    while(n < max && p < end) {
+        const uint8_t f = *p;
+
+        if(static_cast<int8_t>(f) >= -32) {
+            size_t run = impl::fixint_run(
+                p, static_cast<size_t>(
+                       std::min<uint64_t>(max - n, static_cast<uint64_t>(end - p))));
+            p += run;
+            n += run;
+            continue;
         }
 
-        this->pack_raw(data, size);
-        return *this;
+        if((f & 0xE0) != impl::Format::FIXSTR)
+            break;
+
+        size_t len = f & 0x1F;
+        if(static_cast<size_t>(end - p) <= len)
+            break;
+
+        p += len + 1;
+        ++n;
     }
 
-    Type& pack_ext(int8_t t, const ValueType* data, size_t size) {
-        assert(data);
+    return n;
+}
+
+// Past the end of the element at 'p', nullptr when malformed or truncated.
+// Subtrees are skipped by counting pending items, nothing is decoded
+inline const uint8_t* skip(const uint8_t* p, const uint8_t* end) {
+    uint64_t pending = 1;
+
+    for(;;) {
+        pending -= impl::skip_leaves(p, end, pending);
+        if(!pending)
+            return p;
+
+        Header h;
+        if(!impl::parse_header(p, static_cast<size_t>(end - p), h) ||
+           h.kind == Header::INVALID)
+            return nullptr;
+
+        uint64_t payload = 0;
+        if(h.kind == Header::STR || h.kind == Header::BIN || h.kind == Header::EXT)
+            payload = h.value;
+        if(payload > static_cast<uint64_t>(end - p) - h.size)
+            return nullptr;
+
+        p += h.size + payload;
+        --pending;
+
+        if(h.kind == Header::ARRAY || h.kind == Header::MAP) {
+            pending += h.kind == Header::MAP ? h.value * 2 : h.value;
+            if(pending > static_cast<uint64_t>(end - p))
+                return nullptr;
+        }
+    }
+}
+
+template<typename T>
+inline constexpr bool is_packed_int_v = // NOLINT
+    std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+template<typename T, typename = void>
+inline constexpr bool is_int_array_v = false; // NOLINT
+
+template<typename T>
+inline constexpr bool is_int_array_v<T, std::enable_if_t<is_array_v<T>>> = // NOLINT
+    is_packed_int_v<typename T::value_type>;
+
+// Integer conversions with range checks, both sides of the wire
+template<typename T>
+inline T int_cast(int64_t s) {
+    if constexpr(std::is_unsigned_v<T>) {
+        if(s < 0 || static_cast<uint64_t>(s) > std::numeric_limits<T>::max())
+            impl::msgpack_except("MsgPack::unpack_int(): Integer out of range");
+    }
+    else if(s < std::numeric_limits<T>::min() || s > std::numeric_limits<T>::max())
+        impl::msgpack_except("MsgPack::unpack_int(): Integer out of range");
+
+    return static_cast<T>(s);
+}
+
+template<typename T>
+inline T int_cast(uint64_t u) {
+    if(u > static_cast<uint64_t>(std::numeric_limits<T>::max()))
+        impl::msgpack_except("MsgPack::unpack_int(): Integer out of range");
+    return static_cast<T>(u);
+}
+
+// Smallest encoding of 'v' into 'out' (9 bytes at most), returns its size
+template<typename T>
+inline size_t encode_int(uint8_t* out, T v) {
+    if constexpr(std::is_signed_v<T>) {
+        if(v < 0) {
+            auto s = static_cast<int64_t>(v);
+
+            if(s >= -(1 << 5)) {
+                out[0] = static_cast<uint8_t>(s);
+                return 1;
+            }
+            if(s >= std::numeric_limits<int8_t>::min()) {
+                out[0] = Format::INT8;
+                out[1] = static_cast<uint8_t>(s);
+                return 2;
+            }
+            if(s >= std::numeric_limits<int16_t>::min()) {
+                out[0] = Format::INT16;
+                impl::store_bigendian(out + 1, static_cast<int16_t>(s));
+                return 3;
+            }
+            if(s >= std::numeric_limits<int32_t>::min()) {
+                out[0] = Format::INT32;
+                impl::store_bigendian(out + 1, static_cast<int32_t>(s));
+                return 5;
+            }
+
+            out[0] = Format::INT64;
+            impl::store_bigendian(out + 1, s);
+            return 9;
+        }
+    }
+
+    auto u = static_cast<uint64_t>(v);
+
+    if(u < (1 << 7)) {
+        out[0] = static_cast<uint8_t>(u);
+        return 1;
+    }
+    if(u <= std::numeric_limits<uint8_t>::max()) {
+        out[0] = Format::UINT8;
+        out[1] = static_cast<uint8_t>(u);
+        return 2;
+    }
+    if(u <= std::numeric_limits<uint16_t>::max()) {
+        out[0] = Format::UINT16;
+        impl::store_bigendian(out + 1, static_cast<uint16_t>(u));
+        return 3;
+    }
+    if(u <= std::numeric_limits<uint32_t>::max()) {
+        out[0] = Format::UINT32;
+        impl::store_bigendian(out + 1, static_cast<uint32_t>(u));
+        return 5;
+    }
+
+    out[0] = Format::UINT64;
+    impl::store_bigendian(out + 1, u);
+    return 9;
+}
+
+// Size of the timestamp 32, 64 or 96 layout pack_timestamp() picks
+constexpr size_t timestamp_size(const Timestamp& ts) {
+    if(ts.seconds < 0 || (ts.seconds >> 34) != 0)
+        return 15;
+    if(!ts.nanoseconds && ts.seconds <= std::numeric_limits<uint32_t>::max())
+        return 6;
+    return 10;
+}
+
+// Any integer format into T, false when invalid or truncated
+template<typename T>
+inline bool decode_int(const uint8_t*& p, const uint8_t* end, T& t) {
+    if(p == end)
+        return false;
+
+    const uint8_t f = *p;
+
+    if(f < 0x80) {
+        t = impl::int_cast<T>(static_cast<uint64_t>(f));
+        ++p;
+        return true;
+    }
+    if(f >= 0xe0) {
+        t = impl::int_cast<T>(static_cast<int64_t>(static_cast<int8_t>(f)));
+        ++p;
+        return true;
+    }
+
+    const FormatDesc& d = FORMATS[f];
+    if((d.kind != Header::UINT && d.kind != Header::INT) ||
+       static_cast<size_t>(end - p) < d.size)
+        return false;
+
+    const uint64_t v = impl::format_value(d, p);
+
+    if(d.kind == Header::UINT)
+        t = impl::int_cast<T>(v);
+    else {
+        // Sign extension from the field width
+        const unsigned shift = (64U - 8U * d.width) & 63U;
+        t = impl::int_cast<T>(static_cast<int64_t>(v << shift) >> shift);
+    }
+
+    p += d.size;
+    return true;
+}
+
+inline constexpr size_t INT_GROUP = 16;
+
+template<typename T>
+inline bool is_fixint(T v) {
+    if constexpr(std::is_signed_v<T>)
+        return v >= -(1 << 5) && v < (1 << 7);
+    else
+        return v < (1 << 7);
+}
+
+// Whether the INT_GROUP items at 'v' all encode as fixints: SSE2 for 32 bit
+// integers, a branchless loop that compilers vectorize otherwise
+template<typename T>
+inline bool all_fixints(const T* v) {
+#if defined(__SSE2__)
+    if constexpr(sizeof(T) == sizeof(uint32_t)) {
+        // Unsigned lanes are in range exactly when they are in [0, 128) as int32
+        const __m128i lower = _mm_set1_epi32(std::is_signed_v<T> ? -33 : -1);
+        const __m128i upper = _mm_set1_epi32(1 << 7);
+        __m128i ok = _mm_set1_epi32(-1);
+
+        for(size_t i = 0; i < INT_GROUP; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+            ok = _mm_and_si128(ok, _mm_and_si128(_mm_cmpgt_epi32(x, lower),
+                                                 _mm_cmplt_epi32(x, upper)));
+        }
+
+        return _mm_movemask_epi8(ok) == 0xFFFF;
+    }
+#endif
+
+    bool ok = true;
+    for(size_t i = 0; i < INT_GROUP; ++i)
+        ok &= impl::is_fixint(v[i]);
+    return ok;
+}
+
+// By [negative]: the largest magnitude of each field width, with negative
+// values complemented (-33 is 32 for INT8)
+inline constexpr uint64_t INT_LIMITS[2][4] = {
+    {(1 << 7) - 1, std::numeric_limits<uint8_t>::max(),
+     std::numeric_limits<uint16_t>::max(), std::numeric_limits<uint32_t>::max()},
+    {(1 << 5) - 1, std::numeric_limits<int8_t>::max(),
+     std::numeric_limits<int16_t>::max(), std::numeric_limits<int32_t>::max()},
+};
+
+// encode_int()'s field width (0 for fixints) without data dependent branches
+template<typename T>
+constexpr size_t int_width(T v) {
+    using W = std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>;
+    const auto u = static_cast<uint64_t>(static_cast<W>(v));
+    const size_t negative = std::is_signed_v<T> ? u >> 63 : 0;
+    const uint64_t m = u ^ (uint64_t{0} - negative);
+    const uint64_t* limits = INT_LIMITS[negative];
+
+    return static_cast<size_t>(m > limits[0]) + static_cast<size_t>(m > limits[1]) +
+           (static_cast<size_t>(m > limits[2]) << 1) +
+           (static_cast<size_t>(m > limits[3]) << 2);
+}
+
+// Same encoding as encode_int() without data dependent branches, for bulk
+// arrays of mixed magnitudes. Always stores 9 bytes at 'out'
+template<typename T>
+inline size_t encode_int_bulk(uint8_t* out, T v) {
+    // Formats by [negative][field width]
+    static constexpr uint8_t FORMATS[2][9] = {
+        {0, Format::UINT8, Format::UINT16, 0, Format::UINT32, 0, 0, 0, Format::UINT64},
+        {0, Format::INT8, Format::INT16, 0, Format::INT32, 0, 0, 0, Format::INT64},
+    };
+
+    using W = std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>;
+    const auto u = static_cast<uint64_t>(static_cast<W>(v));
+    const size_t negative = std::is_signed_v<T> ? u >> 63 : 0;
+    const size_t width = impl::int_width(v);
+
+    // The field is left aligned in a 64 bit big endian store, fixints are
+    // the format byte itself
+    const auto fixint = static_cast<uint8_t>(u & (uint64_t{0} - (width == 0)));
+    out[0] = FORMATS[negative][width] | fixint;
+    impl::store_bigendian(out + 1, u << ((64 - (width * 8)) & 63));
+    return width + 1;
+}
+
+// Per format byte, the integer it encodes is the 64 bit big endian load past
+// the format byte shifted right by 'shift': fixints are their own format byte
+struct IntFormat {
+    uint8_t size; // Encoded size, 1 for invalid formats
+    uint8_t shift;
+    bool sign;
+    bool valid;
+};
+
+inline constexpr std::array<IntFormat, 256> INT_FORMATS = [] {
+    std::array<IntFormat, 256> t{};
+
+    for(size_t f = 0; f < 0x100; ++f)
+        t[f] = {1, 56, f >= 0xe0, f < 0x80 || f >= 0xe0};
+
+    t[Format::UINT8] = {2, 56, false, true};
+    t[Format::UINT16] = {3, 48, false, true};
+    t[Format::UINT32] = {5, 32, false, true};
+    t[Format::UINT64] = {9, 0, false, true};
+    t[Format::INT8] = {2, 56, true, true};
+    t[Format::INT16] = {3, 48, true, true};
+    t[Format::INT32] = {5, 32, true, true};
+    t[Format::INT64] = {9, 0, true, true};
+    return t;
+}();
+
+// 'n' integers of any format into 'out', false when one is invalid or
+// truncated. Groups of fixints are widened at once, groups of one format are
+// decoded at a fixed stride and mixed groups without data dependent branches,
+// as long as a group can't reach the end
+template<typename T>
+inline bool decode_ints(const uint8_t*& p, const uint8_t* end, T* out, size_t n) {
+    constexpr auto MIN = static_cast<int64_t>(std::numeric_limits<T>::min());
+    constexpr auto MAX = static_cast<uint64_t>(std::numeric_limits<T>::max());
+    constexpr size_t GROUP_BYTES = INT_GROUP * (sizeof(uint64_t) + 1);
+    const uint8_t* q = p;
+    bool invalid = false, range = false;
+    size_t i = 0;
+
+    // Logical or arithmetic shift picked with a mask, the range check is
+    // against MIN for negative values and MAX otherwise
+    auto decode = [&](const IntFormat& d, const uint8_t* at) {
+        const uint64_t raw = impl::load_bigendian<uint64_t>(at + (d.size > 1));
+        const uint64_t u = raw >> d.shift;
+        const auto s = static_cast<uint64_t>(static_cast<int64_t>(raw) >> d.shift);
+        const uint64_t v = u ^ ((s ^ u) & (uint64_t{0} - d.sign));
+        const bool negative = d.sign & (static_cast<int64_t>(v) < 0);
+
+        invalid |= !d.valid;
+        range |= (negative & (static_cast<int64_t>(v) < MIN)) |
+                 (!negative & (v > MAX));
+        return static_cast<T>(v);
+    };
+
+    // A group of one field type 'V' at a fixed stride
+    auto stride = [&](auto v) {
+        using V = decltype(v);
+        bool bad = false;
+
+        for(size_t j = 0; j < INT_GROUP; ++j) {
+            V x = impl::load_bigendian<V>(q + 1 + (j * (sizeof(V) + 1)));
+
+            if constexpr(std::is_signed_v<V>)
+                bad |= (static_cast<int64_t>(x) < MIN) |
+                       ((x >= 0) & (static_cast<uint64_t>(x) > MAX));
+            else
+                bad |= static_cast<uint64_t>(x) > MAX;
+
+            out[i + j] = static_cast<T>(x);
+        }
+
+        range |= bad;
+    };
+
+    for(; n - i >= INT_GROUP && static_cast<size_t>(end - q) >= GROUP_BYTES;
+        i += INT_GROUP) {
+        if(impl::fixint_run(q, INT_GROUP) == INT_GROUP) {
+            uint8_t negative = 0;
+
+            for(size_t j = 0; j < INT_GROUP; ++j) {
+                negative |= q[j];
+                out[i + j] = static_cast<T>(static_cast<int8_t>(q[j]));
+            }
+
+            if constexpr(std::is_unsigned_v<T>)
+                range |= (negative & 0x80) != 0;
+
+            q += INT_GROUP;
+            continue;
+        }
+
+        const IntFormat first = INT_FORMATS[*q];
+        bool same = true;
+
+        for(size_t j = 1; j < INT_GROUP; ++j)
+            same &= q[j * first.size] == *q;
+
+        if(same && first.size > 1) {
+            switch(*q) {
+                case Format::UINT8: stride(uint8_t{}); break;
+                case Format::UINT16: stride(uint16_t{}); break;
+                case Format::UINT32: stride(uint32_t{}); break;
+                case Format::UINT64: stride(uint64_t{}); break;
+                case Format::INT8: stride(int8_t{}); break;
+                case Format::INT16: stride(int16_t{}); break;
+                case Format::INT32: stride(int32_t{}); break;
+                default: stride(int64_t{}); break;
+            }
+
+            q += INT_GROUP * first.size;
+            continue;
+        }
+
+        for(size_t j = 0; j < INT_GROUP; ++j) {
+            const IntFormat& d = INT_FORMATS[*q];
+            out[i + j] = decode(d, q);
+            q += d.size;
+        }
+    }
+
+    p = q;
+
+    if(invalid)
+        return false;
+    if(range)
+        impl::msgpack_except("MsgPack::unpack_int(): Integer out of range");
+
+    for(; i < n; ++i) {
+        if(!impl::decode_int(p, end, out[i]))
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace impl
+
+// Encoding shared by every packer: Derived provides the output through
+// 'void pack_raw(const ValueType*, size_t)'
+template<typename Derived, typename Value>
+class BasicPacker {
+public:
+    using ValueType = Value;
+
+    static_assert(sizeof(ValueType) == sizeof(uint8_t));
+
+    Derived& pack_bin(const ValueType* data, size_t size) {
+        assert(data);
+
+        if(size <= std::numeric_limits<std::uint8_t>::max()) {
+            this->pack_header(impl::Format::BIN8, static_cast<uint8_t>(size));
+        }
+        else if(size <= std::numeric_limits<std::uint16_t>::max()) {
+            this->pack_header(impl::Format::BIN16, static_cast<uint16_t>(size));
+        }
+        else {
+            this->pack_header(impl::Format::BIN32, static_cast<uint32_t>(size));
+        }
+
+        this->derived().pack_payload(data, size);
+        return this->derived();
+    }
+
+    Derived& pack_ext(int8_t t, const ValueType* data, size_t size) {
+        assert(data);
         if(t < 0)
             impl::msgpack_except("MsgPack::pack_ext(): type < 0 is reserved");
 
@@ -419,40 +1468,43 @@ struct BasicMsgPack {
 
             default: {
                 if(size <= std::numeric_limits<std::uint8_t>::max()) {
-                    this->pack_format(impl::Format::EXT8);
-                    this->pack_int(static_cast<uint8_t>(size));
+                    this->pack_header(impl::Format::EXT8, static_cast<uint8_t>(size));
                     this->pack_format(static_cast<uint8_t>(t));
                 }
                 else if(size <= std::numeric_limits<std::uint16_t>::max()) {
-                    this->pack_format(impl::Format::EXT16);
-                    this->pack_int(static_cast<uint16_t>(size));
+                    this->pack_header(impl::Format::EXT16, static_cast<uint16_t>(size));
                     this->pack_format(static_cast<uint8_t>(t));
                 }
                 else {
-                    this->pack_format(impl::Format::EXT32);
-                    this->pack_int(static_cast<uint32_t>(size));
+                    this->pack_header(impl::Format::EXT32, static_cast<uint32_t>(size));
                     this->pack_format(static_cast<uint8_t>(t));
                 }
                 break;
             }
         }
 
-        this->pack_raw(data, size);
-        return *this;
-    }
-
-    template<typename ExtCallback>
-    Type& pack_ext(int8_t t, ExtCallback cb) {
-        ContainerType ext;
-        cb(Type{ext});
-        return this->pack_ext(t, ext.data(), ext.size());
+        this->derived().pack_payload(data, size);
+        return this->derived();
     }
 
     template<typename T>
-    Type& pack(T&& t) {
+    Derived& pack(T&& t) {
         using U = std::decay_t<T>;
 
-        if constexpr(impl::is_array_v<U>) {
+        if constexpr(impl::is_array_v<U> || impl::is_span_v<U>) {
+            using Item = std::remove_cv_t<typename U::value_type>;
+
+            if constexpr(std::is_same_v<Item, double>)
+                this->pack_doubles(t.data(), t.size());
+            else if constexpr(impl::is_packed_int_v<Item>)
+                this->pack_ints(t.data(), t.size());
+            else {
+                this->pack_array(t.size());
+                for(const auto& v : t)
+                    this->pack(v);
+            }
+        }
+        else if constexpr(impl::is_set_v<U>) {
             this->pack_array(t.size());
             for(const auto& v : t)
                 this->pack(v);
@@ -474,185 +1526,150 @@ struct BasicMsgPack {
             this->pack_int(t);
         else if constexpr(std::is_null_pointer_v<U>)
             this->pack_format(impl::Format::NIL);
+        else if constexpr(std::is_same_v<U, float>)
+            this->pack_float(t);
+        else if constexpr(std::is_same_v<U, double>)
+            this->pack_double(t);
+        else if constexpr(std::is_same_v<U, Timestamp>)
+            this->pack_timestamp(t);
+        else if constexpr(impl::is_tuple_v<U>) {
+            this->pack_array(std::tuple_size_v<U>);
+            std::apply([&](const auto&... v) { (this->pack(v), ...); }, t);
+        }
+        else if constexpr(impl::is_reflected_v<U>) {
+            constexpr size_t bound = impl::packed_bound<U>();
+            if constexpr(bound > 0)
+                this->derived().pack_reserve(bound);
+
+            using Fields = decltype(t.msgpack_fields());
+            this->pack_fields(t, std::make_index_sequence<std::tuple_size_v<Fields>>{});
+        }
         else
             static_assert(impl::always_false_v<U>,
                           "MsgPack::pack(): Unsupported type");
-        return *this;
+        return this->derived();
     }
 
-    template<typename T>
-    inline T unpack() {
-        T t;
-        this->unpack(t);
-        return t;
+    // Low Level Interface
+    Derived& pack_map(size_t size) {
+        return this->pack_aggregate(
+            size,
+            {impl::Format::FIXMAP, impl::Format::MAP16, impl::Format::MAP32});
     }
-
-    inline ContainerType unpack_bin() {
-        ContainerType c;
-        this->unpack_bin(c);
-        return c;
+    Derived& pack_array(size_t size) {
+        return this->pack_aggregate(size, {impl::Format::FIXARRAY,
+                                           impl::Format::ARRAY16,
+                                           impl::Format::ARRAY32});
     }
 
-    void unpack_bin(ContainerType& c) {
-        uint8_t f = this->unpack_format();
+protected:
+    inline Derived& derived() { return static_cast<Derived&>(*this); }
 
-        switch(f) {
-            case impl::Format::BIN8: {
-                uint8_t n;
-                this->unpack_int(n);
-                c.resize(n);
-                break;
-            }
+    // Output hint for 'size' more bytes, Derived may override it
+    inline void pack_reserve(size_t /* size */) {}
 
-            case impl::Format::BIN16: {
-                uint16_t n;
-                this->unpack_int(n);
-                c.resize(n);
-                break;
-            }
+    // Bin, str and ext payloads, Derived may override it to keep them by
+    // reference
+    inline void pack_payload(const ValueType* p, size_t size) { this->raw(p, size); }
 
-            case impl::Format::BIN32: {
-                uint32_t n;
-                this->unpack_int(n);
-                c.resize(n);
-                break;
-            }
+    template<typename T, size_t... I>
+    void pack_fields(const T& t, std::index_sequence<I...>) {
+        auto fields = t.msgpack_fields();
 
-            default:
-                impl::msgpack_except(
-                    "MsgPack::unpack_int(): Invalid ext format");
-                break;
+        if constexpr(T::msgpack_map) {
+            constexpr auto names = T::msgpack_names();
+            this->pack_map(sizeof...(I));
+            ((this->pack_string(names[I]), this->pack(std::get<I>(fields))), ...);
+        }
+        else {
+            this->pack_array(sizeof...(I));
+            (this->pack(std::get<I>(fields)), ...);
         }
+    }
 
-        this->unpack_raw(c.data(), c.size());
+    inline void raw(const ValueType* p, size_t size) {
+        this->derived().pack_raw(p, size);
     }
 
-    auto unpack_ext() {
-        uint8_t f = this->unpack_format();
-        std::pair<int8_t, ContainerType> res;
+    inline void pack_bool(bool b) {
+        this->pack_format(b ? impl::Format::TRUE : impl::Format::FALSE);
+    }
 
-        auto unpackfixext = [&](size_t n) {
-            res.first = this->unpack_format();
-            res.second.resize(n);
-        };
+    inline void pack_float(float v) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        this->pack_header(impl::Format::FLOAT32, bits);
+    }
 
-        switch(f) {
-            case impl::Format::FIXEXT1: unpackfixext(1); break;
-            case impl::Format::FIXEXT2: unpackfixext(2); break;
-            case impl::Format::FIXEXT4: unpackfixext(4); break;
-            case impl::Format::FIXEXT8: unpackfixext(8); break;
-
-            case impl::Format::EXT8: {
-                uint8_t n;
-                this->unpack_int(n);
-                res.second.resize(n);
-                res.first = static_cast<int8_t>(this->unpack_format());
-                break;
-            }
+    inline void pack_double(double v) {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        this->pack_header(impl::Format::FLOAT64, bits);
+    }
 
-            case impl::Format::EXT16: {
-                uint16_t n;
-                this->unpack_int(n);
-                res.second.resize(n);
-                res.first = static_cast<int8_t>(this->unpack_format());
-                break;
-            }
+    // Whole arrays of doubles: swapped in blocks, then interleaved with their
+    // format bytes in a staging buffer
+    void pack_doubles(const double* v, size_t n) {
+        constexpr size_t BLOCK = 64;
+        constexpr size_t ITEM = sizeof(double) + 1;
 
-            case impl::Format::EXT32: {
-                uint32_t n;
-                this->unpack_int(n);
-                res.second.resize(n);
-                res.first = static_cast<int8_t>(this->unpack_format());
-                break;
+        std::array<uint64_t, BLOCK> bits;
+        std::array<uint8_t, BLOCK * ITEM> out;
+
+        this->pack_array(n);
+        this->derived().pack_reserve(n * ITEM);
+
+        while(n) {
+            size_t c = std::min(n, BLOCK);
+            impl::swap_doubles_bulk(bits.data(), v, c);
+
+            for(size_t i = 0; i < c; ++i) {
+                out[i * ITEM] = impl::Format::FLOAT64;
+                std::memcpy(&out[(i * ITEM) + 1], &bits[i], sizeof(uint64_t));
             }
 
-            default:
-                impl::msgpack_except(
-                    "MsgPack::unpack_int(): Invalid ext format");
-                break;
+            this->raw(reinterpret_cast<const ValueType*>(out.data()), c * ITEM);
+            v += c;
+            n -= c;
         }
-
-        this->unpack_raw(res.second.data(), res.second.size());
-        return res;
     }
 
-    template<typename T>
-    Type& unpack(T& t) {
-        using U = std::decay_t<T>;
+    // Smallest of the timestamp 32, 64 and 96 layouts
+    void pack_timestamp(const Timestamp& ts) {
+        if(ts.nanoseconds >= 1000000000)
+            impl::msgpack_except("MsgPack::pack(): Invalid timestamp");
 
-        if constexpr(impl::is_array_v<U>) {
-            size_t len = this->unpack_array();
+        auto type = static_cast<uint8_t>(impl::TIMESTAMP_TYPE);
+        uint8_t b[15];
+        size_t n = 0;
 
-            if constexpr(impl::is_vector_v<U>)
-                t.reserve(len);
+        if(ts.seconds >= 0 && (ts.seconds >> 34) == 0) {
+            auto s = static_cast<uint64_t>(ts.seconds);
 
-            for(size_t i = 0; i < len; ++i) {
-                typename U::value_type v;
-                this->unpack(v);
-                if constexpr(impl::is_vector_v<U>)
-                    t.push_back(v);
-                else
-                    t[i] = v;
+            if(!ts.nanoseconds && s <= std::numeric_limits<uint32_t>::max()) {
+                b[0] = impl::Format::FIXEXT4;
+                impl::store_bigendian(b + 2, static_cast<uint32_t>(s));
+                n = 6;
             }
-        }
-        else if constexpr(impl::is_map_v<U>) {
-            size_t len = this->unpack_map();
-
-            for(size_t i = 0; i < len; ++i) {
-                typename U::key_type k;
-                typename U::mapped_type v;
-                this->unpack(k);
-                this->unpack(v);
-                t[k] = v;
+            else {
+                b[0] = impl::Format::FIXEXT8;
+                impl::store_bigendian(
+                    b + 2, (static_cast<uint64_t>(ts.nanoseconds) << 34) | s);
+                n = 10;
             }
+
+            b[1] = type;
         }
-        else if constexpr(impl::is_string_v<U>)
-            this->unpack_string(t);
-        else if constexpr(impl::is_bool_v<U>)
-            this->unpack_bool(t);
-        else if constexpr(std::is_enum_v<U>) {
-            std::underlying_type_t<U> u;
-            this->unpack_int(u);
-            t = static_cast<U>(u);
-        }
-        else if constexpr(std::is_integral_v<U>)
-            this->unpack_int(t);
-        else if constexpr(std::is_null_pointer_v<U>) {
-            std::uint8_t f = this->unpack_format();
-            assert(f == impl::Format::NIL);
-            t = nullptr;
+        else {
+            b[0] = impl::Format::EXT8;
+            b[1] = 12;
+            b[2] = type;
+            impl::store_bigendian(b + 3, ts.nanoseconds);
+            impl::store_bigendian(b + 7, ts.seconds);
+            n = sizeof(b);
         }
-        else
-            static_assert(impl::always_false_v<U>,
-                          "MsgPack::pack(): Unsupported type");
 
-        return *this;
-    }
-
-    // Low Level Interface
-    Type& pack_map(size_t size) {
-        return this->pack_aggregate(
-            size,
-            {impl::Format::FIXMAP, impl::Format::MAP16, impl::Format::MAP32});
-    }
-    Type& pack_array(size_t size) {
-        return this->pack_aggregate(size, {impl::Format::FIXARRAY,
-                                           impl::Format::ARRAY16,
-                                           impl::Format::ARRAY32});
-    }
-    inline size_t unpack_map() {
-        return this->unpack_aggregate(
-            {impl::Format::FIXMAP, impl::Format::MAP16, impl::Format::MAP32});
-    }
-    inline size_t unpack_array() {
-        return this->unpack_aggregate({impl::Format::FIXARRAY,
-                                       impl::Format::ARRAY16,
-                                       impl::Format::ARRAY32});
-    }
-
-private: // Packing
-    inline void pack_bool(bool b) {
-        this->pack_format(b ? impl::Format::TRUE : impl::Format::FALSE);
+        this->raw(reinterpret_cast<const ValueType*>(b), n);
     }
 
     template<typename T>
@@ -661,7 +1678,7 @@ private: // Packing
         const char* p = nullptr;
         size_t sz = 0;
 
-        if constexpr(std::is_same_v<U, std::string> ||
+        if constexpr(impl::is_std_string_v<U> ||
                      std::is_same_v<U, std::string_view>) {
             p = t.data();
             sz = t.size();
@@ -675,166 +1692,621 @@ private: // Packing
             static_assert(impl::always_false_v<U>,
                           "MsgPack::pack_string(): Unsupported string type");
 
-        if(sz <= 31) {
+        if(sz <= 31)
             this->pack_format(impl::Format::FIXSTR | static_cast<uint8_t>(sz));
-            this->pack_raw(p, sz);
-        }
         else if(sz <= std::numeric_limits<std::uint8_t>::max()) {
-            this->pack_format(impl::Format::STR8);
-            this->pack_int(static_cast<uint8_t>(sz));
-            this->pack_raw(p, sz);
+            this->pack_header(impl::Format::STR8, static_cast<uint8_t>(sz));
         }
         else if(sz <= std::numeric_limits<uint16_t>::max()) {
-            this->pack_format(impl::Format::STR16);
-            this->pack_int(static_cast<uint16_t>(sz));
-            this->pack_raw(p, sz);
+            this->pack_header(impl::Format::STR16, static_cast<uint16_t>(sz));
         }
         else if(sz <= std::numeric_limits<uint32_t>::max()) {
-            this->pack_format(impl::Format::STR32);
-            this->pack_int(static_cast<uint32_t>(sz));
-            this->pack_raw(p, sz);
+            this->pack_header(impl::Format::STR32, static_cast<uint32_t>(sz));
         }
         else
             impl::msgpack_except(
                 "MsgPack::pack::string(): Unsupported string size");
+
+        this->derived().pack_payload(reinterpret_cast<const ValueType*>(p), sz);
     }
 
     template<typename T,
              typename = std::enable_if_t<std::is_integral_v<std::decay_t<T>>>>
-    void pack_int(T t) {
-        if constexpr(sizeof(T) > sizeof(uint8_t))
-            t = impl::swap_bigendian(t);
-
-        if constexpr(sizeof(T) == sizeof(uint8_t)) {
-            if constexpr(std::is_signed_v<T>) {
-                if(t < -(1 << 5)) {
-                    this->pack_raw(reinterpret_cast<ValueType*>(&t), sizeof(T));
-                    return;
-                }
+    inline void pack_int(T t) {
+        uint8_t b[sizeof(uint64_t) + 1];
+        this->raw(reinterpret_cast<const ValueType*>(b), impl::encode_int(b, t));
+    }
 
-                this->pack_format(impl::Format::INT8);
-            }
-            else {
-                if(t < (1 << 7)) {
-                    this->pack_raw(reinterpret_cast<ValueType*>(&t), sizeof(T));
-                    return;
-                }
+    // Whole integer arrays through a staging buffer: groups of fixints are
+    // narrowed at once, any other group is encoded without branches
+    template<typename T>
+    void pack_ints(const T* v, size_t n) {
+        constexpr size_t BLOCK = 16 * impl::INT_GROUP;
+        std::array<uint8_t, BLOCK * (sizeof(uint64_t) + 1)> out;
 
-                this->pack_format(impl::Format::UINT8);
-            }
-        }
-        else if constexpr(sizeof(T) == sizeof(uint16_t))
-            this->pack_format(std::is_signed_v<T> ? impl::Format::INT16
-                                                  : impl::Format::UINT16);
-        else if constexpr(sizeof(T) == sizeof(uint32_t))
-            this->pack_format(std::is_signed_v<T> ? impl::Format::INT32
-                                                  : impl::Format::UINT32);
-        else if constexpr(sizeof(T) == sizeof(uint64_t))
-            this->pack_format(std::is_signed_v<T> ? impl::Format::INT64
-                                                  : impl::Format::UINT64);
-        else
-            static_assert(impl::always_false_v<T>,
-                          "MsgPack::pack_int(): Unsupported integer type");
+        this->pack_array(n);
+        this->derived().pack_reserve(n);
 
-        this->pack_raw(reinterpret_cast<const ValueType*>(&t), sizeof(T));
-    }
+        while(n) {
+            size_t c = std::min(n, BLOCK), o = 0, i = 0;
 
-    template<typename T>
-    inline void pack_length(T len) {
-        len = impl::swap_bigendian(len);
-        this->pack_raw(reinterpret_cast<ValueType*>(&len), sizeof(len));
+            for(; i + impl::INT_GROUP <= c; i += impl::INT_GROUP) {
+                if(impl::all_fixints(v + i)) {
+                    for(size_t j = 0; j < impl::INT_GROUP; ++j)
+                        out[o + j] = static_cast<uint8_t>(v[i + j]);
+                    o += impl::INT_GROUP;
+                }
+                else {
+                    for(size_t j = 0; j < impl::INT_GROUP; ++j)
+                        o += impl::encode_int_bulk(out.data() + o, v[i + j]);
+                }
+            }
+
+            for(; i < c; ++i)
+                o += impl::encode_int_bulk(out.data() + o, v[i]);
+
+            this->raw(reinterpret_cast<const ValueType*>(out.data()), o);
+            v += c;
+            n -= c;
+        }
     }
 
-    inline void pack_format(uint8_t f) {
-        this->pack_raw(reinterpret_cast<const ValueType*>(&f), sizeof(uint8_t));
+    // Format byte and its big endian field, written at once
+    template<typename T>
+    inline void pack_header(uint8_t f, T field) {
+        uint8_t h[sizeof(T) + 1];
+        h[0] = f;
+        impl::store_bigendian(h + 1, field);
+        this->raw(reinterpret_cast<const ValueType*>(h), sizeof(h));
     }
 
-    void pack_raw(const ValueType* p, size_t size) {
-        assert(p);
+    template<typename T>
+    inline void pack_length(T len) {
+        uint8_t b[sizeof(T)];
+        impl::store_bigendian(b, len);
+        this->raw(reinterpret_cast<const ValueType*>(b), sizeof(b));
+    }
 
-        if(size) {
-            this->buffer.get().reserve(this->buffer.get().size() + size);
-            std::copy_n(p, size, std::back_inserter(this->buffer.get()));
-        }
+    inline void pack_format(uint8_t f) {
+        this->raw(reinterpret_cast<const ValueType*>(&f), sizeof(uint8_t));
     }
 
-    inline Type& pack_aggregate(size_t size,
-                                const std::array<uint8_t, 3>& formats) {
+    inline Derived& pack_aggregate(size_t size,
+                                   const std::array<uint8_t, 3>& formats) {
         if(size <= 0xF) {
             this->pack_format(formats[0] | static_cast<uint8_t>(size));
         }
         else if(size <= std::numeric_limits<uint16_t>::max()) {
-            this->pack_format(formats[1]);
-            this->pack_length(static_cast<uint16_t>(size));
+            this->pack_header(formats[1], static_cast<uint16_t>(size));
         }
         else if(size <= std::numeric_limits<uint32_t>::max()) {
-            this->pack_format(formats[2]);
-            this->pack_length(static_cast<uint32_t>(size));
+            this->pack_header(formats[2], static_cast<uint32_t>(size));
         }
         else
             impl::msgpack_except("MsgPack::new_aggregate(): Unsupported Size");
 
-        return *this;
+        return this->derived();
     }
+};
 
-private: // Unpacking
-    size_t unpack_aggregate(const std::array<uint8_t, 3>& formats) {
-        uint8_t f = this->unpack_format();
-        size_t len = 0;
+// Packs into a fixed caller-provided buffer, handing it to 'flush' every time it fills up
+template<typename Value, typename Flush>
+class StreamingPacker: public BasicPacker<StreamingPacker<Value, Flush>, Value> {
+    friend class BasicPacker<StreamingPacker<Value, Flush>, Value>;
+
+public:
+    using ValueType = Value;
+
+    explicit StreamingPacker() = delete;
+    StreamingPacker(const StreamingPacker&) = delete;
+    StreamingPacker& operator=(const StreamingPacker&) = delete;
+
+    StreamingPacker(ValueType* buffer, size_t capacity, Flush flush)
+        : m_flush{std::move(flush)}, m_begin{buffer}, m_ptr{buffer},
+          m_end{buffer + capacity} {
+        assert(buffer && capacity);
+    }
+
+    ~StreamingPacker() { this->flush(); }
+
+    // Bytes waiting in the buffer
+    [[nodiscard]] inline size_t pending() const {
+        return static_cast<size_t>(m_ptr - m_begin);
+    }
+
+    // Bytes packed so far, flushed or not
+    [[nodiscard]] inline size_t size() const { return m_flushed + this->pending(); }
+
+    void flush() {
+        if(m_ptr == m_begin)
+            return;
+
+        m_flush(static_cast<const ValueType*>(m_begin), this->pending());
+        m_flushed += this->pending();
+        m_ptr = m_begin;
+    }
 
-        if((f & 0xF0) == formats[0]) {
-            len = f & 0x0F;
+private:
+    inline void pack_raw(const ValueType* p, size_t size) {
+        if(size <= static_cast<size_t>(m_end - m_ptr)) {
+            std::memcpy(m_ptr, p, size);
+            m_ptr += size;
         }
-        else if(f == formats[1])
-            len = this->unpack_length<uint16_t>();
-        else if(f == formats[2])
-            len = this->unpack_length<uint32_t>();
         else
-            impl::msgpack_except("MsgPack::unpack_aggregate(): Invalid Format");
+            this->pack_raw_slow(p, size);
+    }
+
+    void pack_raw_slow(const ValueType* p, size_t size) {
+        assert(p);
+
+        // Top up the buffer, then bypass it for anything that wouldn't fit anyway
+        size_t n = static_cast<size_t>(m_end - m_ptr);
+        std::memcpy(m_ptr, p, n);
+        m_ptr += n;
+        p += n;
+        size -= n;
+        this->flush();
+
+        if(size >= static_cast<size_t>(m_end - m_begin)) {
+            m_flush(p, size);
+            m_flushed += size;
+            return;
+        }
+
+        std::memcpy(m_ptr, p, size);
+        m_ptr += size;
+    }
+
+    Flush m_flush;
+    ValueType *m_begin, *m_ptr, *m_end;
+    size_t m_flushed{0};
+};
+
+#if defined(MSGPACK_IOVEC)
+// Packs into an iovec list for writev()/sendmsg(): headers and small values
+// are copied to an internal buffer, bin/str/ext payloads of 'threshold' bytes
+// or more are referenced in place and must outlive the list
+class IovecPacker: public BasicPacker<IovecPacker, char> {
+    friend class BasicPacker<IovecPacker, char>;
+
+public:
+    using ValueType = char;
+
+    explicit IovecPacker(size_t threshold = 4096): m_threshold{threshold} {}
+
+    IovecPacker(const IovecPacker&) = delete;
+    IovecPacker& operator=(const IovecPacker&) = delete;
+
+    // Valid until the next pack call
+    [[nodiscard]] const std::vector<iovec>& iov() {
+        m_iov.clear();
+        m_iov.reserve(m_segments.size());
+
+        for(const Segment& s : m_segments) {
+            const ValueType* p = s.data ? s.data : m_buffer.data() + s.offset;
+            m_iov.push_back({const_cast<ValueType*>(p), s.size});
+        }
+
+        return m_iov;
+    }
+
+    // Bytes packed so far, copied or referenced
+    [[nodiscard]] inline size_t size() const { return m_size; }
+
+    inline void clear() {
+        m_buffer.clear();
+        m_segments.clear();
+        m_iov.clear();
+        m_size = 0;
+    }
+
+private:
+    // 'data' is null for ranges of m_buffer, that may move until iov()
+    struct Segment {
+        const ValueType* data;
+        size_t offset;
+        size_t size;
+    };
+
+    inline void pack_raw(const ValueType* p, size_t size) {
+        if(m_segments.empty() || m_segments.back().data)
+            m_segments.push_back({nullptr, m_buffer.size(), 0});
+
+        m_buffer.insert(m_buffer.end(), p, p + size);
+        m_segments.back().size += size;
+        m_size += size;
+    }
+
+    inline void pack_payload(const ValueType* p, size_t size) {
+        if(size < m_threshold)
+            return this->pack_raw(p, size);
+
+        m_segments.push_back({p, 0, size});
+        m_size += size;
+    }
+
+    size_t m_threshold;
+    std::vector<ValueType> m_buffer;
+    std::vector<Segment> m_segments;
+    std::vector<iovec> m_iov;
+    size_t m_size{0};
+};
+#endif
+
+// Packs into a caller-provided buffer without any capacity check: the buffer
+// must hold the packed_size() of everything packed into it
+template<typename Value>
+class RawPacker: public BasicPacker<RawPacker<Value>, Value> {
+    friend class BasicPacker<RawPacker<Value>, Value>;
+
+public:
+    using ValueType = Value;
+
+    explicit RawPacker() = delete;
+    explicit RawPacker(ValueType* buffer): m_begin{buffer}, m_ptr{buffer} {
+        assert(buffer);
+    }
+
+    // Bytes packed so far
+    [[nodiscard]] inline size_t size() const {
+        return static_cast<size_t>(m_ptr - m_begin);
+    }
+
+private:
+    inline void pack_raw(const ValueType* p, size_t size) {
+        std::memcpy(m_ptr, p, size);
+        m_ptr += size;
+    }
+
+    ValueType *m_begin, *m_ptr;
+};
+
+template<typename Container>
+struct BasicMsgPack
+    : BasicPacker<BasicMsgPack<Container>, typename Container::value_type> {
+    using Type = BasicMsgPack<Container>;
+    using ContainerType = Container;
+    using ValueType = typename ContainerType::value_type;
+    using Packer = BasicPacker<Type, ValueType>;
+
+    friend Packer;
+    using Packer::pack_ext;
+
+    explicit BasicMsgPack() = delete;
+    explicit BasicMsgPack(ContainerType& c): buffer{c} {}
+    explicit BasicMsgPack(const ContainerType& c)
+        : buffer{const_cast<ContainerType&>(c)}, m_readonly{true} {}
+
+    [[nodiscard]] inline size_t size() const { return this->buffer.get().size(); }
+    inline void rewind() { this->pos = 0; }
+
+    inline void push(const ContainerType& c) {
+        this->buffer.get().insert(this->buffer.get().end(), c.cbegin(), c.cend());
+    }
+
+    [[nodiscard]] inline bool at_end() const {
+        return this->pos >= this->buffer.get().size();
+    }
 
-        return len;
+    template<typename ExtCallback>
+    Type& pack_ext(int8_t t, ExtCallback cb) {
+        ContainerType ext;
+        cb(Type{ext});
+        return this->pack_ext(t, ext.data(), ext.size());
     }
 
     template<typename T>
-    inline T unpack_length() {
-        T len = 0;
-        this->unpack_raw(reinterpret_cast<ValueType*>(&len), sizeof(T));
-        return impl::swap_bigendian(len);
+    inline T unpack() {
+        T t;
+        this->unpack(t);
+        return t;
+    }
+
+    inline ContainerType unpack_bin() {
+        ContainerType c;
+        this->unpack_bin(c);
+        return c;
+    }
+
+    // Lengths are checked against the remaining bytes before any allocation
+    void unpack_bin(ContainerType& c) {
+        auto s = this->unpack_view(this->unpack_bin_header());
+        this->charge(s.size());
+        c.assign(s.data(), s.data() + s.size());
+    }
+
+    auto unpack_ext() {
+        auto [type, n] = this->unpack_ext_header();
+        auto s = this->unpack_view(n);
+        this->charge(n);
+        return std::pair<int8_t, ContainerType>{
+            type, ContainerType(s.data(), s.data() + s.size())};
+    }
+
+    // Caps the bytes the following unpack() calls may allocate: strings, bins,
+    // exts, vector storage, hash buckets and map or set nodes are charged as
+    // they are decoded
+    inline void set_max_alloc(size_t bytes) { m_budget = bytes; }
+
+    // Zero copy: the payload stays in the buffer, valid as long as it is
+    inline Span<const ValueType> unpack_bin_view() {
+        return this->unpack_view(this->unpack_bin_header());
     }
 
+    inline std::pair<int8_t, Span<const ValueType>> unpack_ext_view() {
+        auto [type, n] = this->unpack_ext_header();
+        return {type, this->unpack_view(n)};
+    }
+
+    // Vectors are replaced by the decoded items, fixed arrays overwritten
+    // from the front, maps and sets merged with the decoded entries
     template<typename T>
-    void unpack_string(T& t) {
-        uint8_t f = this->unpack_format();
-        size_t len = 0;
+    Type& unpack(T& t) {
+        using U = std::decay_t<T>;
+
+        if constexpr(impl::is_int_array_v<U>) {
+            size_t len = this->unpack_array();
+
+            // Every item takes a byte at least
+            if(len > this->buffer.get().size() - this->pos)
+                impl::msgpack_except("MsgPack::unpack(): Reached EOB");
 
-        if((f & 0xE0) == impl::Format::FIXSTR) {
-            len = f & 0x1F;
+            if constexpr(impl::is_vector_v<U>) {
+                this->charge(len * sizeof(typename U::value_type));
+                t.resize(len);
+            }
+            else if(len > t.size())
+                impl::msgpack_except("MsgPack::unpack(): Array too long");
+
+            this->unpack_ints(t.data(), len);
+        }
+        else if constexpr(impl::is_array_v<U>) {
+            size_t len = this->unpack_array();
+
+            if constexpr(impl::is_vector_v<U>) {
+                if(len > this->buffer.get().size() - this->pos)
+                    impl::msgpack_except("MsgPack::unpack(): Reached EOB");
+
+                this->charge(len * sizeof(typename U::value_type));
+                t.clear();
+                t.reserve(len);
+            }
+            else if(len > t.size())
+                impl::msgpack_except("MsgPack::unpack(): Array too long");
+
+            // Items are built in place, with the container's allocator
+            for(size_t i = 0; i < len; ++i) {
+                if constexpr(impl::is_vector_v<U> &&
+                             std::is_same_v<typename U::value_type, bool>) {
+                    bool b;
+                    this->unpack(b);
+                    t.push_back(b);
+                }
+                else if constexpr(impl::is_vector_v<U>)
+                    this->unpack(t.emplace_back());
+                else
+                    this->unpack(t[i]);
+            }
+        }
+        else if constexpr(impl::is_map_v<U>) {
+            size_t len = this->unpack_map();
+            this->reserve_items(t, len);
+
+            // Keys are moved in, values decoded in place
+            for(size_t i = 0; i < len; ++i) {
+                auto k = impl::make_item<typename U::key_type>(t.get_allocator());
+                this->unpack(k);
+
+                // Last one wins on duplicate keys
+                auto [it, inserted] = this->emplace_item(t, std::move(k));
+                if(!inserted)
+                    it->second = impl::make_item<typename U::mapped_type>(t.get_allocator());
+
+                this->unpack(it->second);
+            }
+        }
+        else if constexpr(impl::is_set_v<U>) {
+            size_t len = this->unpack_array();
+            this->reserve_items(t, len);
+
+            for(size_t i = 0; i < len; ++i) {
+                auto k = impl::make_item<typename U::key_type>(t.get_allocator());
+                this->unpack(k);
+
+                this->emplace_item(t, std::move(k));
+            }
+        }
+        else if constexpr(impl::is_string_v<U>)
+            this->unpack_string(t);
+        else if constexpr(impl::is_bool_v<U>)
+            this->unpack_bool(t);
+        else if constexpr(std::is_enum_v<U>) {
+            std::underlying_type_t<U> u;
+            this->unpack_int(u);
+            t = static_cast<U>(u);
+        }
+        else if constexpr(std::is_integral_v<U>)
+            this->unpack_int(t);
+        else if constexpr(std::is_null_pointer_v<U>) {
+            std::uint8_t f = this->unpack_format();
+            assert(f == impl::Format::NIL);
+            t = nullptr;
         }
-        else if(f == impl::Format::STR8) {
-            uint8_t l;
-            this->unpack_int(l);
-            len = l;
+        else if constexpr(std::is_floating_point_v<U>)
+            this->unpack_float(t);
+        else if constexpr(std::is_same_v<U, Timestamp>) {
+            auto [type, n] = this->unpack_ext_header();
+            auto s = this->unpack_view(n);
+
+            if(type != impl::TIMESTAMP_TYPE ||
+               !impl::decode_timestamp(reinterpret_cast<const uint8_t*>(s.data()),
+                                       n, t))
+                impl::msgpack_except("MsgPack::unpack(): Invalid timestamp");
         }
-        else if(f == impl::Format::STR16) {
-            uint16_t l;
-            this->unpack_int(l);
-            len = l;
+        else if constexpr(impl::is_tuple_v<U>) {
+            size_t len = this->unpack_array();
+            this->unpack_items(t, len, std::make_index_sequence<std::tuple_size_v<U>>{});
         }
-        else if(f == impl::Format::STR32) {
-            uint32_t l;
-            this->unpack_int(l);
-            len = l;
+        else if constexpr(impl::is_reflected_v<U>) {
+            auto fields = t.msgpack_fields();
+            constexpr size_t n = std::tuple_size_v<decltype(fields)>;
+
+            if constexpr(U::msgpack_map)
+                this->unpack_fields<U>(fields, std::make_index_sequence<n>{});
+            else
+                this->unpack_items(fields, this->unpack_array(),
+                                   std::make_index_sequence<n>{});
         }
         else
-            impl::msgpack_except("MsgPack::unpack_string(): Invalid Format");
+            static_assert(impl::always_false_v<U>,
+                          "MsgPack::pack(): Unsupported type");
+
+        return *this;
+    }
+
+    // Skips the next element without decoding it
+    void skip() {
+        const auto* begin = reinterpret_cast<const uint8_t*>(this->buffer.get().data());
+        const uint8_t* end = begin + this->buffer.get().size();
+        const uint8_t* p = impl::skip(begin + this->pos, end);
+
+        if(!p)
+            impl::msgpack_except("MsgPack::skip(): Invalid or truncated element");
+
+        this->pos = static_cast<size_t>(p - begin);
+    }
+
+    // Low Level Interface
+    inline size_t unpack_map() { return this->unpack_aggregate(impl::Header::MAP); }
+    inline size_t unpack_array() { return this->unpack_aggregate(impl::Header::ARRAY); }
+
+private: // Packing
+    // Geometric growth: exact reserves would reallocate on every call
+    inline void pack_reserve(size_t size) {
+        ContainerType& c = this->buffer.get();
+        if(c.size() + size > c.capacity())
+            c.reserve(std::max(c.size() + size, c.capacity() * 2));
+    }
+
+    inline void pack_raw(const ValueType* p, size_t size) {
+        assert(p);
+
+        ContainerType& c = this->buffer.get();
+        size_t n = c.size();
+        c.resize(n + size);
+        std::memcpy(c.data() + n, p, size);
+    }
 
-        if constexpr(std::is_same_v<T, std::string>) {
-            t.resize(len);
-            this->unpack_raw(t.data(), len);
+private: // Unpacking
+    // Positional members: missing trailing items keep their value, extra
+    // ones are skipped
+    template<typename Tuple, size_t... I>
+    void unpack_items(Tuple&& tuple, size_t len, std::index_sequence<I...>) {
+        ((I < len ? (void)this->unpack(std::get<I>(tuple)) : (void)0), ...);
+
+        for(size_t i = sizeof...(I); i < len; ++i)
+            this->skip();
+    }
+
+    // Named members: each key is resolved to its member through the compile
+    // time perfect hash of the names, then compared to that one name only.
+    // Unknown keys are skipped along with their values
+    template<typename T, typename Tuple, size_t... I>
+    void unpack_fields(Tuple&& tuple, std::index_sequence<I...>) {
+        constexpr const auto& KEYS = impl::key_table_v<T>;
+
+        size_t len = this->unpack_map();
+
+        for(size_t i = 0; i < len; ++i) {
+            if(impl::FORMATS[this->peek_format()].kind != impl::Header::STR) {
+                this->skip();
+                this->skip();
+                continue;
+            }
+
+            std::string_view key;
+            this->unpack_string(key);
+
+            size_t f = KEYS.candidate(key);
+            bool found = ((f == I && key == KEYS.names[I]
+                               ? (this->unpack(std::get<I>(tuple)), true)
+                               : false) ||
+                          ...);
+
+            if(!found)
+                this->skip();
+        }
+    }
+
+    inline uint8_t peek_format() const {
+        if(this->pos >= this->buffer.get().size())
+            impl::msgpack_except("MsgPack::peek_format(): Reached EOB");
+        return static_cast<uint8_t>(this->buffer.get()[this->pos]);
+    }
+
+    // Descriptor of the next format byte, which has to be of 'kind'
+    inline const impl::FormatDesc& peek_desc(impl::Header::Kind kind,
+                                             const char* errmsg) const {
+        const impl::FormatDesc& d = impl::FORMATS[this->peek_format()];
+        if(d.kind != kind)
+            impl::msgpack_except(errmsg);
+        return d;
+    }
+
+    // Consumes a 'kind' header, returns its length, count or scalar bits
+    inline uint64_t unpack_header(impl::Header::Kind kind, const char* errmsg) {
+        const impl::FormatDesc& d = this->peek_desc(kind, errmsg);
+        return impl::format_value(d, this->unpack_bytes(d.size));
+    }
+
+    size_t unpack_bin_header() {
+        return this->unpack_header(impl::Header::BIN,
+                                   "MsgPack::unpack_bin(): Invalid bin format");
+    }
+
+    std::pair<int8_t, size_t> unpack_ext_header() {
+        const impl::FormatDesc& d = this->peek_desc(
+            impl::Header::EXT, "MsgPack::unpack_ext(): Invalid ext format");
+        const uint8_t* p = this->unpack_bytes(d.size);
+        return {static_cast<int8_t>(p[d.size - 1]), impl::format_value(d, p)};
+    }
+
+    inline Span<const ValueType> unpack_view(size_t size) {
+        return {reinterpret_cast<const ValueType*>(this->unpack_bytes(size)), size};
+    }
+
+    [[nodiscard]] inline const uint8_t* data() const {
+        return reinterpret_cast<const uint8_t*>(this->buffer.get().data());
+    }
+
+    // Consumes the next 'size' bytes: the one bounds check of each value
+    inline const uint8_t* unpack_bytes(size_t size) {
+        if(size > this->buffer.get().size() - this->pos)
+            impl::msgpack_except("MsgPack::unpack_bytes(): Reached EOB");
+
+        const auto* p =
+            reinterpret_cast<const uint8_t*>(this->buffer.get().data()) + this->pos;
+        this->pos += size;
+        return p;
+    }
+
+    inline size_t unpack_aggregate(impl::Header::Kind kind) {
+        return this->unpack_header(kind, "MsgPack::unpack_aggregate(): Invalid Format");
+    }
+
+    template<typename T>
+    void unpack_string(T& t) {
+        const size_t len = this->unpack_header(
+            impl::Header::STR, "MsgPack::unpack_string(): Invalid Format");
+
+        if constexpr(impl::is_std_string_v<T>) {
+            const uint8_t* p = this->unpack_bytes(len);
+            this->charge(len);
+            t.assign(reinterpret_cast<const char*>(p), len);
         }
         else if constexpr(std::is_same_v<T, std::string_view>) {
-            t = std::string_view{this->buffer.get().data() + this->pos, len};
-            this->pos += len;
+            auto s = this->unpack_view(len);
+            t = std::string_view{reinterpret_cast<const char*>(s.data()), len};
         }
         else if constexpr(std::is_same_v<T, char const*>)
             this->unpack_raw(&t, len);
@@ -843,104 +2315,755 @@ private: // Unpacking
                           "MsgPack::unpack_string(): Invalid type");
     }
 
+    // Any integer format, range checked against T
     template<typename T,
              typename = std::enable_if_t<std::is_integral_v<std::decay_t<T>>>>
     void unpack_int(T& t) {
-        using U = std::decay_t<T>;
-        uint8_t f = this->unpack_format();
+        const uint8_t* begin = this->data();
+        const uint8_t* p = begin + this->pos;
 
-        switch(f) {
-            case impl::Format::INT8: assert((std::is_same_v<U, int8_t>)); break;
-            case impl::Format::INT16:
-                assert((std::is_same_v<U, int16_t>));
-                break;
-            case impl::Format::INT32:
-                assert((std::is_same_v<U, int32_t>));
+        if(!impl::decode_int(p, begin + this->buffer.get().size(), t))
+            impl::msgpack_except("MsgPack::unpack_int(): Invalid integer format");
+
+        this->pos = static_cast<size_t>(p - begin);
+    }
+
+    // 'n' array items into 'out', see impl::decode_ints()
+    template<typename T>
+    void unpack_ints(T* out, size_t n) {
+        const uint8_t* begin = this->data();
+        const uint8_t* p = begin + this->pos;
+
+        if(!impl::decode_ints(p, begin + this->buffer.get().size(), out, n))
+            impl::msgpack_except("MsgPack::unpack_int(): Invalid integer format");
+
+        this->pos = static_cast<size_t>(p - begin);
+    }
+
+    // Either width converts to the requested floating point type
+    template<typename T>
+    void unpack_float(T& t) {
+        const impl::FormatDesc& d = this->peek_desc(
+            impl::Header::FLOAT, "MsgPack::unpack_float(): Invalid Format");
+        impl::Header h{impl::Header::FLOAT, d.size,
+                       impl::format_value(d, this->unpack_bytes(d.size)), 0};
+
+        if(d.width == sizeof(float))
+            t = static_cast<T>(impl::header_float<float>(h));
+        else
+            t = static_cast<T>(impl::header_float<double>(h));
+    }
+
+    void unpack_bool(bool& b) {
+        b = this->unpack_header(impl::Header::BOOL,
+                                "MsgPack::unpack_bool(): Invalid Format") != 0;
+    }
+
+    inline uint8_t unpack_format() { return *this->unpack_bytes(sizeof(uint8_t)); }
+
+    // Bucket arrays of hashed containers sized once, 'len' is checked
+    // against the remaining bytes first as every item takes one at least
+    template<typename T>
+    inline void reserve_items(T& t, size_t len) {
+        if constexpr(impl::is_unordered_v<T>) {
+            if(len > this->buffer.get().size() - this->pos)
+                impl::msgpack_except("MsgPack::unpack(): Reached EOB");
+
+            this->charge(len * sizeof(void*));
+            t.reserve(t.size() + len);
+        }
+    }
+
+    // Ordered containers are hinted at their end: sorted input, as pack()
+    // writes it, inserts in constant time. Mapped values are default built
+    template<typename T, typename K>
+    std::pair<typename T::iterator, bool> emplace_item(T& t, K&& k) {
+        if constexpr(impl::is_unordered_v<T>) {
+            auto res = [&]() {
+                if constexpr(impl::is_map_v<T>)
+                    return t.try_emplace(std::forward<K>(k));
+                else
+                    return t.emplace(std::forward<K>(k));
+            }();
+
+            if(res.second)
+                this->charge(sizeof(typename T::value_type));
+            return res;
+        }
+        else {
+            const size_t n = t.size();
+            typename T::iterator it;
+
+            if constexpr(impl::is_map_v<T>)
+                it = t.try_emplace(t.end(), std::forward<K>(k));
+            else
+                it = t.emplace_hint(t.end(), std::forward<K>(k));
+
+            if(t.size() == n)
+                return {it, false};
+
+            this->charge(sizeof(typename T::value_type));
+            return {it, true};
+        }
+    }
+
+    inline void charge(size_t bytes) {
+        if(bytes > m_budget)
+            impl::msgpack_except("MsgPack::unpack(): Allocation budget exceeded");
+        m_budget -= bytes;
+    }
+
+    inline void unpack_raw(ValueType* p, size_t size) {
+        assert(p);
+        if(size)
+            std::memcpy(p, this->unpack_bytes(size), size);
+    }
+
+public:
+    std::reference_wrapper<Container> buffer;
+    bool m_readonly{false};
+    size_t pos{};
+
+private:
+    size_t m_budget{MSGPACK_MAX_ALLOC};
+};
+
+// Push decoder: feed() it chunks of any size as they arrive, visitor events
+// are emitted as soon as each element is complete. Nesting is tracked on an
+// explicit stack, so partial messages need no buffering on this side: an
+// element cut by the end of a chunk is left unconsumed, the caller passes
+// those bytes again in front of the next chunk
+template<typename VisitorType, typename Container = std::string>
+class StreamingDecoder {
+public:
+    using ContainerType = Container;
+    using ValueType = typename ContainerType::value_type;
+    using IntegerType = typename std::decay_t<VisitorType>::IntegerType;
+
+    static_assert(sizeof(ValueType) == sizeof(uint8_t));
+
+    explicit StreamingDecoder(VisitorType& visitor): m_visitor{visitor} {}
+
+    // Bytes consumed: the rest is an incomplete element, or the visitor stopped
+    size_t feed(const ValueType* data, size_t size) {
+        assert(data || !size);
+
+        const auto* p = reinterpret_cast<const uint8_t*>(data);
+        const uint8_t* const start = p;
+        const uint8_t* const end = p + size;
+
+        while(!m_stopped) {
+            if(!m_stack.empty() && !this->next_slot())
                 break;
-            case impl::Format::INT64:
-                assert((std::is_same_v<U, int64_t>));
+
+            impl::Header h;
+            if(!impl::parse_header(p, static_cast<size_t>(end - p), h))
                 break;
-            case impl::Format::UINT8:
-                assert((std::is_same_v<U, uint8_t>));
+            if(h.kind == impl::Header::INVALID)
+                impl::msgpack_except("StreamingDecoder::feed(): Invalid Format");
+
+            size_t payload = 0;
+            if(h.kind == impl::Header::STR || h.kind == impl::Header::BIN ||
+               h.kind == impl::Header::EXT)
+                payload = h.value;
+
+            if(static_cast<size_t>(end - p) - h.size < payload)
                 break;
-            case impl::Format::UINT16:
-                assert((std::is_same_v<U, uint16_t>));
+
+            const uint8_t* body = p + h.size;
+            p = body + payload;
+
+            if(!this->emit(h, body))
                 break;
-            case impl::Format::UINT32:
-                assert((std::is_same_v<U, uint32_t>));
+        }
+
+        return static_cast<size_t>(p - start);
+    }
+
+    // At a message boundary: no container left open
+    [[nodiscard]] inline bool done() const { return m_stack.empty(); }
+    [[nodiscard]] inline bool stopped() const { return m_stopped; }
+    [[nodiscard]] inline size_t depth() const { return m_stack.size(); }
+
+    inline void reset() {
+        m_stack.clear();
+        m_stopped = false;
+    }
+
+private:
+    struct Frame {
+        bool map;
+        bool value;   // Map only: the current slot is a value
+        bool started; // start_*() emitted for the current slot
+        uint64_t size;
+        uint64_t index;
+    };
+
+    // Close finished containers, then open the next slot of the innermost one
+    bool next_slot() {
+        while(!m_stack.empty()) {
+            Frame& f = m_stack.back();
+
+            if(f.index == f.size) {
+                bool map = f.map;
+                m_stack.pop_back();
+
+                if(!(map ? m_visitor.end_map() : m_visitor.end_array()) ||
+                   !this->end_item())
+                    return this->stop();
+                continue;
+            }
+
+            if(!f.started) {
+                size_t i = f.index;
+                bool ok = !f.map    ? m_visitor.start_array_item(i)
+                          : f.value ? m_visitor.start_map_value(i)
+                                    : m_visitor.start_map_key(i);
+                if(!ok)
+                    return this->stop();
+                f.started = true;
+            }
+
+            return true;
+        }
+
+        return true;
+    }
+
+    // An element has been completed in the innermost container
+    bool end_item() {
+        if(m_stack.empty())
+            return true;
+
+        Frame& f = m_stack.back();
+        size_t i = f.index;
+        bool ok = true;
+
+        if(!f.map) {
+            ok = m_visitor.end_array_item(i);
+            ++f.index;
+        }
+        else if(f.value) {
+            ok = m_visitor.end_map_value(i);
+            f.value = false;
+            ++f.index;
+        }
+        else {
+            ok = m_visitor.end_map_key(i);
+            f.value = true;
+        }
+
+        f.started = false;
+        return ok || this->stop();
+    }
+
+    bool emit(const impl::Header& h, const uint8_t* body) {
+        bool ok = true;
+
+        switch(h.kind) {
+            case impl::Header::NIL: ok = m_visitor.visit_nil(); break;
+            case impl::Header::BOOL: ok = m_visitor.visit_bool(h.value != 0); break;
+
+            case impl::Header::UINT:
+            case impl::Header::INT:
+                ok = m_visitor.visit_int(impl::header_integer<IntegerType>(
+                    h, static_cast<uint8_t>(h.size - 1)));
                 break;
-            case impl::Format::UINT64:
-                assert((std::is_same_v<U, uint64_t>));
+
+            case impl::Header::FLOAT:
+                if(h.size == sizeof(float) + 1)
+                    ok = m_visitor.visit_float(impl::header_float<float>(h));
+                else
+                    ok = m_visitor.visit_double(impl::header_float<double>(h));
                 break;
 
-            default: {
-                int sel = static_cast<int>(f);
+            case impl::Header::STR:
+                ok = m_visitor.visit_str(std::string_view{
+                    reinterpret_cast<const char*>(body), h.value});
+                break;
 
-                if(sel >= 0x00 && sel <= 0x7F) { // Positive FIXNUM
-                    t = static_cast<T>(static_cast<uint8_t>(f));
-                    return;
-                }
+            case impl::Header::BIN:
+                ok = m_visitor.visit_bin(
+                    Span<const ValueType>{reinterpret_cast<const ValueType*>(body),
+                                          static_cast<size_t>(h.value)});
+                break;
 
-                if(sel >= 0xe0 && sel <= 0xFF) { // Negative FIXNUM
-                    t = static_cast<T>(static_cast<int8_t>(f));
-                    return;
+            case impl::Header::EXT: {
+                if(h.type == impl::TIMESTAMP_TYPE) {
+                    Timestamp ts;
+                    if(!impl::decode_timestamp(body, h.value, ts))
+                        impl::msgpack_except("StreamingDecoder::feed(): Invalid timestamp");
+                    ok = m_visitor.visit_timestamp(ts);
+                    break;
                 }
 
-                impl::msgpack_except(
-                    "MsgPack::unpack_int(): Invalid integer format");
+                ok = m_visitor.visit_ext(
+                    h.type,
+                    Span<const ValueType>{reinterpret_cast<const ValueType*>(body),
+                                          static_cast<size_t>(h.value)});
                 break;
             }
+
+            case impl::Header::ARRAY:
+            case impl::Header::MAP: {
+                if(m_stack.size() >= MSGPACK_MAX_DEPTH)
+                    impl::msgpack_except("StreamingDecoder::feed(): Maximum depth exceeded");
+
+                bool map = h.kind == impl::Header::MAP;
+                if(!(map ? m_visitor.start_map(h.value)
+                         : m_visitor.start_array(h.value)))
+                    return this->stop();
+
+                m_stack.push_back({map, false, false, h.value, 0});
+                return true;
+            }
+
+            default: break;
         }
 
-        this->unpack_raw(reinterpret_cast<ValueType*>(&t), sizeof(U));
-        if constexpr(sizeof(U) > sizeof(uint8_t))
-            t = impl::swap_bigendian(t);
+        if(!ok)
+            return this->stop();
+        return this->end_item();
     }
 
-    void unpack_bool(bool& b) {
-        uint8_t f = this->unpack_format();
-        if(f == impl::Format::TRUE)
-            b = true;
-        else if(f == impl::Format::FALSE)
-            b = false;
+    inline bool stop() {
+        m_stopped = true;
+        return false;
+    }
+
+private:
+    VisitorType& m_visitor;
+    std::vector<Frame> m_stack;
+    bool m_stopped{false};
+};
+
+class Index;
+
+template<typename Bytes>
+bool validate(const Bytes& data, Index& index, size_t depth = 1,
+              size_t maxdepth = MSGPACK_MAX_DEPTH);
+
+namespace impl {
+
+struct NullIndex {
+    static constexpr bool ENABLED = false;
+};
+
+template<typename IndexType>
+bool scan(const uint8_t* begin, const uint8_t* end, size_t maxdepth,
+          IndexType& index);
+
+} // namespace impl
+
+// Structural index built by validate(): every element up to depth() in
+// document order, containers point to the contiguous block of their children
+class Index {
+public:
+    static constexpr size_t NPOS = std::numeric_limits<size_t>::max();
+
+    struct Node {
+        size_t offset;   // Element start
+        size_t end;      // One past the element, children included
+        uint64_t count;  // Items (array), pairs (map), payload bytes otherwise
+        size_t children; // Children block, NPOS when not indexed
+        uint32_t depth;
+        impl::Header::Kind kind;
+    };
+
+    [[nodiscard]] inline size_t size() const { return m_nodes.size(); }
+    [[nodiscard]] inline size_t depth() const { return m_depth; }
+    [[nodiscard]] inline bool empty() const { return m_nodes.empty(); }
+    [[nodiscard]] inline const Node& operator[](size_t i) const { return m_nodes[i]; }
+
+    // Top level elements, one per message
+    [[nodiscard]] inline const std::vector<size_t>& roots() const {
+        return m_roots;
+    }
+
+    // Children lookups return nullptr when out of range or not indexed
+    [[nodiscard]] inline const Node* item(const Node& n, size_t i) const {
+        return n.kind == impl::Header::ARRAY ? this->child(n, i) : nullptr;
+    }
+
+    [[nodiscard]] inline const Node* key(const Node& n, size_t i) const {
+        return n.kind == impl::Header::MAP ? this->child(n, i * 2) : nullptr;
+    }
+
+    [[nodiscard]] inline const Node* value(const Node& n, size_t i) const {
+        return n.kind == impl::Header::MAP ? this->child(n, (i * 2) + 1)
+                                           : nullptr;
+    }
+
+    void clear() {
+        m_nodes.clear();
+        m_children.clear();
+        m_roots.clear();
+    }
+
+private:
+    static constexpr bool ENABLED = true;
+
+    const Node* child(const Node& n, size_t i) const {
+        uint64_t slots = n.kind == impl::Header::MAP ? n.count * 2 : n.count;
+        if(n.children == NPOS || i >= slots)
+            return nullptr;
+        return &m_nodes[m_children[n.children + i]];
+    }
+
+    [[nodiscard]] inline bool indexed(size_t depth) const {
+        return depth <= m_depth;
+    }
+
+    size_t add(size_t slot, const Node& n) {
+        size_t id = m_nodes.size();
+        m_nodes.push_back(n);
+
+        if(slot == NPOS)
+            m_roots.push_back(id);
         else
-            impl::msgpack_except("MsgPack::unpack_bool(): Invalid Format");
+            m_children[slot] = id;
+
+        return id;
     }
 
-    uint8_t unpack_format() {
-        uint8_t f;
-        this->unpack_raw(reinterpret_cast<ValueType*>(&f), sizeof(uint8_t));
-        return f;
+    // Callers guarantee 'n' to be bounded by the input size
+    size_t reserve(size_t id, uint64_t n) {
+        size_t slot = m_children.size();
+        m_children.resize(slot + static_cast<size_t>(n), NPOS);
+        m_nodes[id].children = slot;
+        return slot;
     }
 
-    void unpack_raw(ValueType* p, size_t size) {
-        assert(p);
+    template<typename IndexType>
+    friend bool impl::scan(const uint8_t*, const uint8_t*, size_t, IndexType&);
+
+    template<typename Bytes>
+    friend bool validate(const Bytes&, Index&, size_t, size_t);
+
+private:
+    std::vector<Node> m_nodes;
+    std::vector<size_t> m_children, m_roots;
+    size_t m_depth{0};
+};
+
+namespace impl {
+
+// Iterative well-formedness pass: every container count is checked against
+// the remaining bytes (each item takes one at least), so the explicit stack
+// and the index never grow past the input size
+template<typename IndexType>
+bool scan(const uint8_t* begin, const uint8_t* end, size_t maxdepth,
+          IndexType& index) {
+    struct Frame {
+        uint64_t remaining;
+        size_t node;
+        size_t slot;
+    };
+
+    std::vector<Frame> stack;
+    const uint8_t* p = begin;
+
+    for(;;) {
+        if(!stack.empty()) {
+            Frame& f = stack.back();
+
+            if(!f.remaining) {
+                if constexpr(IndexType::ENABLED) {
+                    if(f.node != Index::NPOS)
+                        index.m_nodes[f.node].end = static_cast<size_t>(p - begin);
+                }
+
+                stack.pop_back();
+                continue;
+            }
+
+            bool leaves = true;
+            if constexpr(IndexType::ENABLED)
+                leaves = !index.indexed(stack.size());
+
+            if(leaves) {
+                uint64_t n = impl::skip_leaves(p, end, f.remaining);
+                f.remaining -= n;
+                if(n)
+                    continue;
+            }
+        }
+        else if(p == end)
+            return true;
+
+        Header h;
+        if(!impl::parse_header(p, static_cast<size_t>(end - p), h) ||
+           h.kind == Header::INVALID)
+            return false;
+
+        uint64_t payload = 0;
+        if(h.kind == Header::STR || h.kind == Header::BIN || h.kind == Header::EXT)
+            payload = h.value;
+
+        if(payload > static_cast<uint64_t>(end - p) - h.size)
+            return false;
+
+        const size_t depth = stack.size();
+        size_t node = Index::NPOS;
+
+        if constexpr(IndexType::ENABLED) {
+            if(index.indexed(depth)) {
+                size_t slot = stack.empty() ? Index::NPOS : stack.back().slot++;
+                node = index.add(slot, {static_cast<size_t>(p - begin), 0, h.value,
+                                        Index::NPOS, static_cast<uint32_t>(depth),
+                                        h.kind});
+            }
+        }
 
-        if(size) {
-            auto endpos = this->pos + size;
-            if(endpos > this->buffer.get().size())
-                impl::msgpack_except("MsgPack::unpack_raw(): Reached EOB");
-            std::copy_n(this->buffer.get().begin() + this->pos, size, p);
-            this->pos = endpos;
+        p += h.size + payload;
+        if(!stack.empty())
+            --stack.back().remaining;
+
+        if(h.kind == Header::ARRAY || h.kind == Header::MAP) {
+            uint64_t n = h.kind == Header::MAP ? h.value * 2 : h.value;
+            if(n > static_cast<uint64_t>(end - p) || depth >= maxdepth)
+                return false;
+
+            size_t slot = Index::NPOS;
+            if constexpr(IndexType::ENABLED) {
+                if(node != Index::NPOS && index.indexed(depth + 1))
+                    slot = index.reserve(node, n);
+            }
+
+            stack.push_back({n, node, slot});
+        }
+        else if constexpr(IndexType::ENABLED) {
+            if(node != Index::NPOS)
+                index.m_nodes[node].end = static_cast<size_t>(p - begin);
         }
     }
+}
+
+} // namespace impl
 
+// Well-formedness check without decoding: valid format bytes, lengths and
+// counts within the buffer, at most 'maxdepth' nested containers. 'data' is
+// any contiguous byte range holding zero or more messages
+template<typename Bytes>
+bool validate(const Bytes& data, size_t maxdepth = MSGPACK_MAX_DEPTH) {
+    static_assert(sizeof(*data.data()) == sizeof(uint8_t));
+
+    impl::NullIndex index;
+    const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+    return impl::scan(p, p + data.size(), maxdepth, index);
+}
+
+// As above, also indexing the elements up to 'depth' (top level is 0). The
+// index is left empty when validation fails
+template<typename Bytes>
+bool validate(const Bytes& data, Index& index, size_t depth,
+              size_t maxdepth) {
+    static_assert(sizeof(*data.data()) == sizeof(uint8_t));
+
+    index.clear();
+    index.m_depth = depth;
+
+    const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+    if(impl::scan(p, p + data.size(), maxdepth, index))
+        return true;
+
+    index.clear();
+    return false;
+}
+
+// Lazy random access over an encoded element: lookups walk the raw bytes and
+// skip whole subtrees by length, nothing is allocated until as<T>() builds a
+// value. A failed lookup yields an invalid View rather than an error
+class View {
 public:
-    std::reference_wrapper<Container> buffer;
-    bool m_readonly{false};
-    size_t pos{};
+    using Kind = impl::Header::Kind;
+
+    View() = default;
+
+    View(const uint8_t* data, size_t size) {
+        assert(data || !size);
+
+        impl::Header h;
+        if(!impl::parse_header(data, size, h) || h.kind == impl::Header::INVALID)
+            return;
+
+        if(this->has_payload(h) && h.value > size - h.size)
+            return;
+
+        m_data = data;
+        m_end = data + size;
+        m_header = h;
+    }
+
+    // First element of any contiguous byte range
+    template<typename Bytes>
+    explicit View(const Bytes& data)
+        : View{reinterpret_cast<const uint8_t*>(data.data()), data.size()} {
+        static_assert(sizeof(*data.data()) == sizeof(uint8_t));
+    }
+
+    [[nodiscard]] inline bool valid() const { return m_data; }
+    [[nodiscard]] inline explicit operator bool() const { return m_data; }
+    [[nodiscard]] inline Kind kind() const { return m_header.kind; }
+
+    // Items (array), pairs (map), payload bytes (str, bin, ext)
+    [[nodiscard]] inline size_t size() const {
+        if(!m_data || !(this->has_payload(m_header) || this->is_container()))
+            return 0;
+        return static_cast<size_t>(m_header.value);
+    }
+
+    // Encoded bytes of the element, children included
+    [[nodiscard]] std::string_view raw() const {
+        const uint8_t* end = m_data ? impl::skip(m_data, m_end) : nullptr;
+        if(!end)
+            return {};
+
+        return {reinterpret_cast<const char*>(m_data),
+                static_cast<size_t>(end - m_data)};
+    }
+
+    // Map value with a string key
+    View operator[](std::string_view key) const {
+        if(!m_data || m_header.kind != impl::Header::MAP)
+            return {};
+
+        const uint8_t* p = m_data + m_header.size;
+
+        for(uint64_t i = 0; i < m_header.value; ++i) {
+            View k{p, static_cast<size_t>(m_end - p)};
+            if(!k)
+                return {};
+
+            const uint8_t* v = impl::skip(p, m_end);
+            if(!v)
+                return {};
+
+            if(k.m_header.kind == impl::Header::STR && k.str() == key)
+                return {v, static_cast<size_t>(m_end - v)};
+
+            p = impl::skip(v, m_end);
+            if(!p)
+                return {};
+        }
+
+        return {};
+    }
+
+    // Array item
+    View at(size_t index) const {
+        if(!m_data || m_header.kind != impl::Header::ARRAY ||
+           index >= m_header.value)
+            return {};
+
+        const uint8_t* p = m_data + m_header.size;
+
+        for(size_t i = 0; p && i < index; ++i)
+            p = impl::skip(p, m_end);
+
+        if(!p)
+            return {};
+        return {p, static_cast<size_t>(m_end - p)};
+    }
+
+    // Scalars and strings are read straight from the header, anything else
+    // goes through BasicMsgPack over the element bytes
+    template<typename T>
+    T as() const {
+        using U = std::decay_t<T>;
+
+        if(!m_data)
+            impl::msgpack_except("View::as(): Invalid View");
+
+        if constexpr(impl::is_bool_v<U>) {
+            if(m_header.kind != impl::Header::BOOL)
+                impl::msgpack_except("View::as(): Not a boolean");
+            return m_header.value != 0;
+        }
+        else if constexpr(std::is_integral_v<U>) {
+            if(m_header.kind == impl::Header::UINT) {
+                if(m_header.value > static_cast<uint64_t>(std::numeric_limits<U>::max()))
+                    impl::msgpack_except("View::as(): Integer out of range");
+            }
+            else if(m_header.kind == impl::Header::INT) {
+                auto v = static_cast<int64_t>(m_header.value);
+                if constexpr(std::is_unsigned_v<U>) {
+                    if(v < 0)
+                        impl::msgpack_except("View::as(): Integer out of range");
+                }
+                else if(v < std::numeric_limits<U>::min() ||
+                        v > std::numeric_limits<U>::max())
+                    impl::msgpack_except("View::as(): Integer out of range");
+            }
+            else
+                impl::msgpack_except("View::as(): Not an integer");
+
+            return static_cast<U>(m_header.value);
+        }
+        else if constexpr(std::is_floating_point_v<U>) {
+            if(m_header.kind != impl::Header::FLOAT)
+                impl::msgpack_except("View::as(): Not a floating point");
+
+            if(m_header.size == sizeof(float) + 1)
+                return static_cast<U>(impl::header_float<float>(m_header));
+            return static_cast<U>(impl::header_float<double>(m_header));
+        }
+        else if constexpr(std::is_same_v<U, std::string_view> ||
+                          std::is_same_v<U, std::string>) {
+            if(m_header.kind != impl::Header::STR)
+                impl::msgpack_except("View::as(): Not a string");
+            return U{this->str()};
+        }
+        else if constexpr(std::is_null_pointer_v<U>) {
+            if(m_header.kind != impl::Header::NIL)
+                impl::msgpack_except("View::as(): Not nil");
+            return nullptr;
+        }
+        else {
+            std::string_view bytes = this->raw();
+            if(bytes.empty())
+                impl::msgpack_except("View::as(): Truncated element");
+
+            U u{};
+            BasicMsgPack<std::string_view>{bytes}.unpack(u);
+            return u;
+        }
+    }
+
+private:
+    [[nodiscard]] static inline bool has_payload(const impl::Header& h) {
+        return h.kind == impl::Header::STR || h.kind == impl::Header::BIN ||
+               h.kind == impl::Header::EXT;
+    }
+
+    [[nodiscard]] inline bool is_container() const {
+        return m_header.kind == impl::Header::ARRAY ||
+               m_header.kind == impl::Header::MAP;
+    }
+
+    [[nodiscard]] inline std::string_view str() const {
+        return {reinterpret_cast<const char*>(m_data + m_header.size),
+                static_cast<size_t>(m_header.value)};
+    }
+
+private:
+    const uint8_t* m_data{nullptr};
+    const uint8_t* m_end{nullptr};
+    impl::Header m_header{};
 };
 
 using MsgPack = BasicMsgPack<std::string>;
 using Visitor = BasicVisitor<std::string>;
 
+// Visitor events for every message in 'c', containers nested deeper than
+// 'maxdepth' (MSGPACK_MAX_DEPTH at most) throw
 template<typename MsgPackType = MsgPack, typename VisitorType>
 VisitorType& visit(const typename MsgPackType::ContainerType& c,
-                   VisitorType&& visitor) {
+                   VisitorType&& visitor, size_t maxdepth = MSGPACK_MAX_DEPTH) {
     MsgPackType mp{c};
 
     while(mp.pos < c.size()) {
-        if(!impl::visit(mp, std::forward<VisitorType>(visitor)))
+        if(!impl::visit(mp, visitor, maxdepth))
             break;
     }
 
@@ -955,12 +3078,153 @@ typename MsgPackType::ContainerType pack(T&& t) {
     return c;
 }
 
+// Exact size of pack(t)'s output, a sizing pass with the same format choices.
+// Constant evaluated for literal types
+template<typename T>
+constexpr size_t packed_size(const T& t) {
+    using U = std::decay_t<T>;
+
+    if constexpr(impl::is_array_v<U> || impl::is_span_v<U>) {
+        size_t n = impl::aggregate_bound(t.size());
+
+        using Item = std::remove_cv_t<typename U::value_type>;
+
+        if constexpr(std::is_same_v<Item, double>)
+            return n + (t.size() * (sizeof(double) + 1));
+        else if constexpr(impl::is_packed_int_v<Item>) {
+            for(Item v : t)
+                n += impl::int_width(v) + 1;
+            return n;
+        }
+        else {
+            for(const auto& v : t)
+                n += msgpack::packed_size(v);
+            return n;
+        }
+    }
+    else if constexpr(impl::is_set_v<U>) {
+        size_t n = impl::aggregate_bound(t.size());
+        for(const auto& v : t)
+            n += msgpack::packed_size(v);
+        return n;
+    }
+    else if constexpr(impl::is_map_v<U>) {
+        size_t n = impl::aggregate_bound(t.size());
+        for(const auto& [key, value] : t)
+            n += msgpack::packed_size(key) + msgpack::packed_size(value);
+        return n;
+    }
+    else if constexpr(impl::is_string_v<U>)
+        return impl::string_bound(std::string_view{t}.size());
+    else if constexpr(impl::is_bool_v<U> || std::is_null_pointer_v<U>)
+        return 1;
+    else if constexpr(std::is_enum_v<U>)
+        return impl::int_width(static_cast<std::underlying_type_t<U>>(t)) + 1;
+    else if constexpr(std::is_integral_v<U>)
+        return impl::int_width(t) + 1;
+    else if constexpr(std::is_same_v<U, float> || std::is_same_v<U, double>)
+        return sizeof(U) + 1;
+    else if constexpr(std::is_same_v<U, Timestamp>)
+        return impl::timestamp_size(t);
+    else if constexpr(impl::is_tuple_v<U>) {
+        return impl::aggregate_bound(std::tuple_size_v<U>) +
+               std::apply([](const auto&... v) {
+                   return (msgpack::packed_size(v) + ... + size_t{0});
+               }, t);
+    }
+    else if constexpr(impl::is_reflected_v<U>) {
+        auto fields = t.msgpack_fields();
+        size_t n = impl::aggregate_bound(std::tuple_size_v<decltype(fields)>);
+
+        if constexpr(U::msgpack_map) {
+            for(std::string_view name : U::msgpack_names())
+                n += impl::string_bound(name.size());
+        }
+
+        return n + std::apply([](const auto&... v) {
+                   return (msgpack::packed_size(v) + ... + size_t{0});
+               }, fields);
+    }
+    else
+        static_assert(impl::always_false_v<U>,
+                      "msgpack::packed_size(): Unsupported type");
+}
+
+// Packs 't' into 'out' with no capacity checks, 'out' must hold
+// packed_size(t) bytes. Returns the bytes written
+template<typename T>
+size_t pack_into(Span<std::byte> out, const T& t) {
+    assert(msgpack::packed_size(t) <= out.size());
+
+    RawPacker<std::byte> p{out.data()};
+    p.pack(t);
+    return p.size();
+}
+
+// pack() with a single allocation of the exact size
+template<typename T, typename MsgPackType = MsgPack>
+typename MsgPackType::ContainerType pack_exact(const T& t) {
+    typename MsgPackType::ContainerType c;
+    c.resize(msgpack::packed_size(t));
+
+    RawPacker<typename MsgPackType::ValueType> p{c.data()};
+    p.pack(t);
+    assert(p.size() == c.size());
+    return c;
+}
+
 template<typename T, typename MsgPackType = MsgPack>
-void unpack(typename MsgPackType::ContainerType& buffer, T& t) {
+void unpack(typename MsgPackType::ContainerType& buffer, T& t,
+            size_t maxalloc = MSGPACK_MAX_ALLOC) {
     MsgPackType mp{buffer};
+    mp.set_max_alloc(maxalloc);
     mp.unpack(t);
 }
 
+#if defined(MSGPACK_PMR)
+// Decodes into a T built on 'mr': with pmr containers and strings every
+// node, array and string of the tree is allocated from 'mr'
+template<typename T, typename MsgPackType = MsgPack>
+T unpack(const typename MsgPackType::ContainerType& buffer,
+         std::pmr::memory_resource* mr) {
+    T t = impl::make_item<T>(std::pmr::polymorphic_allocator<char>{mr});
+    MsgPackType mp{buffer};
+    mp.unpack(t);
+    return t;
+}
+
+// Monotonic decoding arena: decoded trees live in its buffers and are freed
+// all at once by reset() or the destructor, without running their
+// destructors. Decode pmr types only, anything holding memory from
+// elsewhere would leak
+class Arena {
+public:
+    explicit Arena(size_t initial = 4096,
+                   std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : m_resource{initial, upstream} {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    [[nodiscard]] inline std::pmr::memory_resource* resource() { return &m_resource; }
+    inline void reset() { m_resource.release(); }
+
+    // Valid until the next reset()
+    template<typename T, typename MsgPackType = MsgPack>
+    T& unpack(const typename MsgPackType::ContainerType& buffer) {
+        void* p = m_resource.allocate(sizeof(T), alignof(T));
+        T* t = new(p) T(impl::make_item<T>(std::pmr::polymorphic_allocator<char>{&m_resource}));
+
+        MsgPackType mp{buffer};
+        mp.unpack(*t);
+        return *t;
+    }
+
+private:
+    std::pmr::monotonic_buffer_resource m_resource;
+};
+#endif
+
 } // namespace msgpack
 
 #if defined(MSGPACK_NAMESPACE)
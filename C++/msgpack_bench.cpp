@@ -0,0 +1,451 @@
+// MsgPack benchmark suite, results are printed as a single JSON document.
+// Every corpus is a stream of messages, encoded and decoded with both the
+// std::string and the std::vector<uint8_t> containers. Only the basic
+// pack()/unpack()/visit() interface is used, so the same file builds against
+// older revisions of msgpack.h for before/after comparisons.
+//
+// Usage: msgpack_bench [scale]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fmt/core.h>
+#include "msgpack.h"
+
+namespace {
+
+size_t g_allocations = 0; // Every operator new, see below
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++g_allocations;
+    if(void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double MIN_SECONDS = 0.5; // Each case repeats for this long at least
+
+struct Options {
+    size_t scale{1};
+};
+
+struct Result {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> fields;
+
+    Result& set(const std::string& k, const std::string& v) {
+        fields.emplace_back(k, fmt::format("\"{}\"", v));
+        return *this;
+    }
+
+    // Rates and latencies
+    Result& set(const std::string& k, double v) {
+        fields.emplace_back(k, fmt::format("{:.3f}", v));
+        return *this;
+    }
+
+    // Counts and sizes
+    Result& set(const std::string& k, size_t v) {
+        fields.emplace_back(k, fmt::format("{}", v));
+        return *this;
+    }
+};
+
+std::vector<Result> g_results;
+
+Result& report(const std::string& name) { return g_results.emplace_back(Result{name, {}}); }
+
+void print_report() {
+    fmt::print("{{\n  \"benchmarks\": [\n");
+
+    for(size_t i = 0; i < g_results.size(); ++i) {
+        const Result& r = g_results[i];
+        fmt::print("    {{\"name\": \"{}\"", r.name);
+        for(const auto& [k, v] : r.fields) fmt::print(", \"{}\": {}", k, v);
+        fmt::print("}}{}\n", i + 1 < g_results.size() ? "," : "");
+    }
+
+    fmt::print("  ]\n}}\n");
+}
+
+// Fastest of the calls made in MIN_SECONDS, the least noisy figure
+template<typename Function>
+double measure_ns(Function f) {
+    double best = std::numeric_limits<double>::max();
+    auto start = Clock::now();
+
+    do {
+        auto t = Clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - t).count());
+    } while(std::chrono::duration<double>(Clock::now() - start).count() < MIN_SECONDS);
+
+    return best;
+}
+
+// Allocations made by a single call
+template<typename Function>
+double count_allocations(Function f) {
+    size_t n = g_allocations;
+    f();
+    return static_cast<double>(g_allocations - n);
+}
+
+// Types with pack()/unpack() members encode themselves, anything else is a
+// single pack()/unpack() call
+template<typename T, typename = void>
+constexpr bool has_codec_v = false;
+
+template<typename T>
+constexpr bool has_codec_v<T, std::void_t<decltype(&T::template pack<msgpack::MsgPack>)>> = true;
+
+template<typename MsgPackType, typename T>
+void encode(MsgPackType& mp, const T& t) {
+    if constexpr(has_codec_v<T>) t.pack(mp);
+    else mp.pack(t);
+}
+
+template<typename MsgPackType, typename T>
+void decode(MsgPackType& mp, T& t) {
+    if constexpr(has_codec_v<T>) t.unpack(mp);
+    else mp.unpack(t);
+}
+
+// Small and large magnitudes, so every integer width shows up
+std::vector<std::vector<int64_t>> int_corpus(size_t scale) {
+    std::mt19937_64 rng{1};
+    std::vector<std::vector<int64_t>> c(1000 * scale);
+
+    for(auto& v : c) {
+        v.resize(100);
+        for(int64_t& i : v) i = static_cast<int64_t>(rng()) >> (rng() % 64);
+    }
+
+    return c;
+}
+
+// Feature vectors: long homogeneous arrays, mostly small values
+std::vector<std::vector<int32_t>> int_array_corpus(size_t scale) {
+    std::mt19937_64 rng{3};
+    std::geometric_distribution<int32_t> dist{0.01};
+    std::vector<std::vector<int32_t>> c(10 * scale);
+
+    for(auto& v : c) {
+        v.resize(10000);
+        for(int32_t& i : v) i = (rng() & 1) ? dist(rng) : -dist(rng);
+    }
+
+    return c;
+}
+
+std::vector<std::map<std::string, std::string>> string_corpus(size_t scale) {
+    std::mt19937_64 rng{2};
+    std::uniform_int_distribution<size_t> len{4, 200};
+    std::vector<std::map<std::string, std::string>> c(1000 * scale);
+
+    for(auto& m : c) {
+        for(size_t i = 0; i < 8; ++i)
+            m["field" + std::to_string(i)] = std::string(len(rng), static_cast<char>('a' + (rng() % 26)));
+    }
+
+    return c;
+}
+
+// Counters, feature flags, ... : one map of a thousand entries per message
+std::vector<std::map<std::string, int64_t>> wide_map_corpus(size_t scale) {
+    std::mt19937_64 rng{5};
+    std::vector<std::map<std::string, int64_t>> c(20 * scale);
+
+    for(auto& m : c) {
+        for(size_t i = 0; i < 1000; ++i)
+            m["metric." + std::to_string(rng() % 100000)] = static_cast<int64_t>(rng() >> (rng() % 64));
+    }
+
+    return c;
+}
+
+// Request envelopes as an RPC layer sends them: small, many, mostly headers
+struct Envelope {
+    uint32_t id;
+    std::string method;
+    std::map<std::string, std::string> meta;
+    std::vector<int64_t> params;
+
+    template<typename MsgPackType>
+    void pack(MsgPackType& mp) const {
+        mp.pack_array(4);
+        mp.pack(id);
+        mp.pack(method);
+        mp.pack(meta);
+        mp.pack(params);
+    }
+
+    template<typename MsgPackType>
+    void unpack(MsgPackType& mp) {
+        mp.unpack_array();
+        mp.unpack(id);
+        mp.unpack(method);
+        mp.unpack(meta);
+        mp.unpack(params);
+    }
+};
+
+std::vector<Envelope> rpc_corpus(size_t scale) {
+    static const char* const METHODS[] = {"get", "put", "delete", "list", "watch", "health"};
+
+    std::mt19937_64 rng{6};
+    std::vector<Envelope> c(20000 * scale);
+    uint32_t id = 0;
+
+    for(Envelope& e : c) {
+        e.id = ++id;
+        e.method = std::string{"store."} + METHODS[rng() % 6];
+        e.meta["trace"] = fmt::format("{:016x}", rng());
+        if(rng() & 1) e.meta["deadline_ms"] = std::to_string(rng() % 5000);
+        e.params.resize(rng() % 4);
+        for(int64_t& p : e.params) p = static_cast<int64_t>(rng() % 100000);
+    }
+
+    return c;
+}
+
+// Arrays nested 'depth' levels deep: [depth, [depth - 1, ... [0, leaf]]].
+// Decoded level by level, no fixed type can hold arbitrary nesting
+struct Deep {
+    uint64_t depth;
+    int64_t leaf;
+
+    template<typename MsgPackType>
+    void pack(MsgPackType& mp) const {
+        for(uint64_t i = depth;; --i) {
+            mp.pack_array(2);
+            mp.pack(i);
+            if(!i) break;
+        }
+
+        mp.pack(leaf);
+    }
+
+    template<typename MsgPackType>
+    void unpack(MsgPackType& mp) {
+        for(depth = 0;; ++depth) {
+            uint64_t i;
+            mp.unpack_array();
+            mp.unpack(i);
+            if(!i) break;
+        }
+
+        mp.unpack(leaf);
+    }
+};
+
+std::vector<Deep> deep_corpus(size_t scale) {
+    std::mt19937_64 rng{7};
+    std::vector<Deep> c(2000 * scale);
+
+    for(Deep& d : c) {
+        d.depth = 32 + (rng() % 96);
+        d.leaf = static_cast<int64_t>(rng());
+    }
+
+    return c;
+}
+
+// Large payloads: images, compressed pages, ... copied as a whole
+template<typename Container>
+struct Blob {
+    Container bytes;
+
+    template<typename MsgPackType>
+    void pack(MsgPackType& mp) const {
+        mp.pack_bin(bytes.data(), bytes.size());
+    }
+
+    template<typename MsgPackType>
+    void unpack(MsgPackType& mp) {
+        mp.unpack_bin(bytes);
+    }
+};
+
+template<typename Container>
+std::vector<Blob<Container>> bin_corpus(size_t scale) {
+    std::mt19937_64 rng{8};
+    std::vector<Blob<Container>> c(16 * scale);
+
+    for(auto& b : c) {
+        b.bytes.resize((256 << 10) + (rng() % (768 << 10)));
+        for(auto& v : b.bytes) v = static_cast<typename Container::value_type>(rng());
+    }
+
+    return c;
+}
+
+// Records of every scalar kind plus a short array and a small map, packed
+// field by field as a stream of messages
+struct Record {
+    uint64_t id;
+    std::string name;
+    double score;
+    bool active;
+    std::vector<int64_t> tags;
+    std::map<std::string, std::string> attrs;
+
+    template<typename MsgPackType>
+    void pack(MsgPackType& mp) const {
+        mp.pack(id);
+        mp.pack(name);
+        mp.pack(score);
+        mp.pack(active);
+        mp.pack(tags);
+        mp.pack(attrs);
+    }
+
+    template<typename MsgPackType>
+    void unpack(MsgPackType& mp) {
+        mp.unpack(id);
+        mp.unpack(name);
+        mp.unpack(score);
+        mp.unpack(active);
+        mp.unpack(tags);
+        mp.unpack(attrs);
+    }
+};
+
+std::vector<Record> mixed_corpus(size_t scale) {
+    std::mt19937_64 rng{4};
+    std::vector<Record> c(10000 * scale);
+
+    for(Record& r : c) {
+        r.id = rng() >> (rng() % 64);
+        r.name = std::string(4 + (rng() % 28), static_cast<char>('a' + (rng() % 26)));
+        r.score = static_cast<double>(rng() % 100000) / 7.0;
+        r.active = rng() & 1;
+        r.tags.resize(rng() % 8);
+        for(int64_t& t : r.tags) t = static_cast<int64_t>(rng() % 1000) - 500;
+        for(size_t i = rng() % 4; i > 0; --i) r.attrs["k" + std::to_string(i)] = std::to_string(rng());
+    }
+
+    return c;
+}
+
+// Counts leaves, the cheapest complete walk of a document
+template<typename Container>
+struct CountingVisitor: msgpack::BasicVisitor<Container> {
+    using IntegerType = typename msgpack::BasicVisitor<Container>::IntegerType;
+
+    size_t n{0};
+
+    bool visit_nil() { ++n; return true; }
+    bool visit_bool(bool) { ++n; return true; }
+    bool visit_int(IntegerType) { ++n; return true; }
+    bool visit_double(double) { ++n; return true; }
+    bool visit_str(std::string_view) { ++n; return true; }
+
+    template<typename Bytes>
+    bool visit_bin(const Bytes&) { ++n; return true; }
+};
+
+template<typename Container>
+constexpr const char* container_name() {
+    return std::is_same_v<Container, std::string> ? "string" : "vector";
+}
+
+// Objects are the corpus items, each one packed as one or more messages
+template<typename Container, typename T>
+void bench_corpus(const char* name, const std::vector<T>& corpus) {
+    using MsgPackType = msgpack::BasicMsgPack<Container>;
+
+    auto pack = [&]() {
+        Container b;
+        MsgPackType mp{b};
+        for(const T& t : corpus) encode(mp, t);
+        return b;
+    };
+
+    auto unpack = [&](const Container& b) {
+        MsgPackType mp{b};
+        size_t n = 0;
+
+        for(size_t i = 0; i < corpus.size(); ++i) {
+            T t{};
+            decode(mp, t);
+            n += mp.pos;
+        }
+
+        if(!n) std::abort(); // Keep the loop alive
+    };
+
+    auto visit = [&](const Container& b) {
+        CountingVisitor<Container> v;
+        msgpack::visit<MsgPackType>(b, v);
+        if(v.n < corpus.size()) std::abort();
+    };
+
+    const Container buffer = pack();
+    auto mb = static_cast<double>(buffer.size()) / (1024.0 * 1024.0);
+    auto objects = static_cast<double>(corpus.size());
+
+    struct Case {
+        const char* name;
+        double ns;
+        double allocations;
+    };
+
+    const Case cases[] = {
+        {"pack", measure_ns([&]() { if(pack().size() != buffer.size()) std::abort(); }),
+         count_allocations([&]() { pack(); })},
+        {"unpack", measure_ns([&]() { unpack(buffer); }), count_allocations([&]() { unpack(buffer); })},
+        {"visit", measure_ns([&]() { visit(buffer); }), count_allocations([&]() { visit(buffer); })},
+    };
+
+    for(const Case& c : cases) {
+        report(c.name)
+            .set("corpus", name)
+            .set("container", container_name<Container>())
+            .set("bytes", buffer.size())
+            .set("mb_per_sec", mb * 1e9 / c.ns)
+            .set("objects_per_sec", objects * 1e9 / c.ns)
+            .set("allocs_per_object", c.allocations / objects);
+    }
+}
+
+template<typename Container>
+void bench_container(const Options& o) {
+    bench_corpus<Container>("rpc", rpc_corpus(o.scale));
+    bench_corpus<Container>("wide_map", wide_map_corpus(o.scale));
+    bench_corpus<Container>("deep", deep_corpus(o.scale));
+    bench_corpus<Container>("int_heavy", int_corpus(o.scale));
+    bench_corpus<Container>("int_array", int_array_corpus(o.scale));
+    bench_corpus<Container>("bin", bin_corpus<Container>(o.scale));
+    bench_corpus<Container>("string_heavy", string_corpus(o.scale));
+    bench_corpus<Container>("mixed", mixed_corpus(o.scale));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    if(argc > 1) o.scale = std::max<size_t>(1, std::strtoull(argv[1], nullptr, 10));
+
+    bench_container<std::string>(o);
+    bench_container<std::vector<uint8_t>>(o);
+
+    print_report();
+    return 0;
+}
@@ -0,0 +1,426 @@
+#pragma once
+
+// Framed reading of concatenated MsgPack messages, e.g. append-only logs:
+// over a read-only mapping or any file descriptor, with a sparse sidecar
+// index of message offsets for seeking, and a parallel mode splitting a
+// mapping at indexed message boundaries. Messages are handed out as
+// std::string_view, ready for BasicMsgPack<std::string_view> or visit()
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "msgpack.h"
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#error "MsgPack: Unsupported operating system"
+#endif
+
+#if defined(MSGPACK_NAMESPACE)
+namespace MSGPACK_NAMESPACE {
+#endif
+
+namespace msgpack {
+
+namespace impl {
+
+inline constexpr uint32_t FRAME_INDEX_MAGIC = 0x5849504D; // "MPIX"
+inline constexpr uint32_t FRAME_INDEX_VERSION = 1;
+
+// Past the message starting at 'offset', 0 at an incomplete or malformed tail
+inline size_t next_frame(std::string_view data, size_t offset) {
+    const auto* begin = reinterpret_cast<const uint8_t*>(data.data());
+    const uint8_t* p = impl::skip(begin + offset, begin + data.size());
+    return p ? static_cast<size_t>(p - begin) : 0;
+}
+
+} // namespace impl
+
+// Read-only private mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filepath) {
+        m_fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+        if(m_fd == -1)
+            impl::msgpack_except("MappedFile(): Cannot open file");
+
+        struct stat st{};
+        if(::fstat(m_fd, &st) == -1) {
+            ::close(m_fd);
+            impl::msgpack_except("MappedFile(): Cannot stat file");
+        }
+
+        m_size = static_cast<size_t>(st.st_size);
+        if(!m_size)
+            return;
+
+        void* m = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if(m == MAP_FAILED) {
+            ::close(m_fd);
+            impl::msgpack_except("MappedFile(): Cannot map file");
+        }
+
+        ::madvise(m, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(m);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if(m_data)
+            ::munmap(const_cast<char*>(m_data), m_size);
+        ::close(m_fd);
+    }
+
+    [[nodiscard]] inline std::string_view data() const { return {m_data, m_size}; }
+    [[nodiscard]] inline size_t size() const { return m_size; }
+
+private:
+    int m_fd{-1};
+    const char* m_data{nullptr};
+    size_t m_size{0};
+};
+
+// Offsets of every 'stride'-th message of a log, 0 included. Logs only grow:
+// update() indexes what was appended since the previous call
+class FrameIndex {
+public:
+    static constexpr uint64_t DEFAULT_STRIDE = 1024;
+
+    explicit FrameIndex(uint64_t stride = DEFAULT_STRIDE): m_stride{stride} {
+        assert(stride);
+    }
+
+    // Stops before an incomplete or malformed tail, the next update() resumes
+    // there. A shorter 'data' than indexed means a new file: start over
+    void update(std::string_view data) {
+        if(data.size() < m_size)
+            this->clear();
+
+        size_t offset = m_size;
+
+        while(offset < data.size()) {
+            size_t next = impl::next_frame(data, offset);
+            if(!next)
+                break;
+
+            if(m_messages % m_stride == 0)
+                m_offsets.push_back(offset);
+
+            ++m_messages;
+            offset = next;
+        }
+
+        m_size = offset;
+    }
+
+    inline void clear() {
+        m_offsets.clear();
+        m_messages = 0;
+        m_size = 0;
+    }
+
+    [[nodiscard]] inline uint64_t stride() const { return m_stride; }
+    [[nodiscard]] inline uint64_t messages() const { return m_messages; }
+    [[nodiscard]] inline uint64_t indexed_size() const { return m_size; } // Bytes
+    [[nodiscard]] inline const std::vector<uint64_t>& offsets() const { return m_offsets; }
+
+    // Indexed message closest to message 'n' from below: its offset and its
+    // number, the rest is skipped message by message
+    [[nodiscard]] std::pair<uint64_t, uint64_t> locate(uint64_t n) const {
+        if(m_offsets.empty())
+            return {0, 0};
+
+        uint64_t i = std::min<uint64_t>(n / m_stride, m_offsets.size() - 1);
+        return {m_offsets[i], i * m_stride};
+    }
+
+    // Sidecar file: header, then the offsets in native byte order
+    void save(const std::string& filepath) const {
+        const std::string tmp = filepath + ".tmp";
+        std::FILE* f = std::fopen(tmp.c_str(), "wb");
+        if(!f)
+            impl::msgpack_except("FrameIndex::save(): Cannot create file");
+
+        Header h{impl::FRAME_INDEX_MAGIC, impl::FRAME_INDEX_VERSION, m_stride,
+                 m_messages, m_size, m_offsets.size()};
+
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+        if(ok && !m_offsets.empty())
+            ok = std::fwrite(m_offsets.data(), sizeof(uint64_t), m_offsets.size(), f) ==
+                 m_offsets.size();
+
+        ok = (std::fclose(f) == 0) && ok;
+        if(!ok || std::rename(tmp.c_str(), filepath.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            impl::msgpack_except("FrameIndex::save(): Cannot write file");
+        }
+    }
+
+    // False when missing or not a valid index, left empty then
+    bool load(const std::string& filepath) {
+        this->clear();
+
+        std::FILE* f = std::fopen(filepath.c_str(), "rb");
+        if(!f)
+            return false;
+
+        // Every field is checked before use: the count against the file
+        // size, each offset against the previous one and the indexed size
+        struct stat st{};
+        Header h{};
+        bool ok = ::fstat(::fileno(f), &st) == 0 &&
+                  std::fread(&h, sizeof(h), 1, f) == 1 &&
+                  h.magic == impl::FRAME_INDEX_MAGIC &&
+                  h.version == impl::FRAME_INDEX_VERSION && h.stride &&
+                  h.messages <= h.size && // A message takes a byte at least
+                  h.count == (h.messages / h.stride) + (h.messages % h.stride != 0) &&
+                  (static_cast<uint64_t>(st.st_size) - sizeof(h)) % sizeof(uint64_t) == 0 &&
+                  h.count == (static_cast<uint64_t>(st.st_size) - sizeof(h)) / sizeof(uint64_t);
+
+        if(ok) {
+            m_offsets.resize(h.count);
+            ok = std::fread(m_offsets.data(), sizeof(uint64_t), h.count, f) == h.count;
+        }
+
+        for(size_t i = 0; ok && i < m_offsets.size(); ++i) {
+            ok = i ? m_offsets[i] > m_offsets[i - 1] && m_offsets[i] < h.size
+                   : m_offsets[i] == 0;
+        }
+
+        std::fclose(f);
+
+        if(!ok) {
+            this->clear();
+            return false;
+        }
+
+        m_stride = h.stride;
+        m_messages = h.messages;
+        m_size = h.size;
+        return true;
+    }
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t stride;
+        uint64_t messages;
+        uint64_t size;
+        uint64_t count;
+    };
+
+    uint64_t m_stride;
+    uint64_t m_messages{0};
+    uint64_t m_size{0};
+    std::vector<uint64_t> m_offsets;
+};
+
+// Sequential messages of a mapped (or loaded) log. An incomplete tail, a
+// message still being appended, or malformed bytes end the iteration:
+// offset() is where it stopped
+class FrameReader {
+public:
+    explicit FrameReader(std::string_view data, uint64_t offset = 0)
+        : m_data{data}, m_offset{std::min<uint64_t>(offset, data.size())} {}
+
+    bool next(std::string_view& msg) {
+        if(m_offset >= m_data.size())
+            return false;
+
+        size_t next = impl::next_frame(m_data, m_offset);
+        if(!next)
+            return false;
+
+        msg = m_data.substr(m_offset, next - m_offset);
+        m_offset = next;
+        return true;
+    }
+
+    // Callback 'f(msg, offset)' for each message, returns how many
+    template<typename Function>
+    uint64_t for_each(Function&& f) {
+        std::string_view msg;
+        uint64_t n = 0;
+
+        for(uint64_t offset = m_offset; this->next(msg); offset = m_offset, ++n)
+            f(msg, offset);
+
+        return n;
+    }
+
+    // 'offset' has to be a message boundary
+    inline void seek(uint64_t offset) {
+        m_offset = std::min<uint64_t>(offset, m_data.size());
+    }
+
+    // Before message 'n': an indexed boundary, then at most stride - 1 skips.
+    // False when there are fewer than 'n' messages
+    bool seek(const FrameIndex& index, uint64_t n) {
+        auto [offset, i] = index.locate(n);
+        this->seek(offset);
+
+        std::string_view msg;
+        for(; i < n; ++i) {
+            if(!this->next(msg))
+                return false;
+        }
+
+        return true;
+    }
+
+    [[nodiscard]] inline uint64_t offset() const { return m_offset; }
+    [[nodiscard]] inline bool at_end() const { return m_offset == m_data.size(); }
+
+private:
+    std::string_view m_data;
+    uint64_t m_offset;
+};
+
+// Sequential messages read from a file descriptor (file, pipe, socket) in
+// chunks. Each message is valid until the next call, 'maxmessage' bounds
+// the buffering of one that never completes
+class StreamFrameReader {
+public:
+    static constexpr size_t DEFAULT_CHUNK = size_t{1} << 20;
+    static constexpr size_t DEFAULT_MAX_MESSAGE = size_t{1} << 28;
+
+    explicit StreamFrameReader(int fd, size_t chunk = DEFAULT_CHUNK,
+                               size_t maxmessage = DEFAULT_MAX_MESSAGE)
+        : m_fd{fd}, m_chunk{chunk}, m_maxmessage{maxmessage} {
+        assert(fd != -1 && chunk);
+    }
+
+    // False at the end of the stream, an incomplete tail is left in pending()
+    bool next(std::string_view& msg) {
+        for(;;) {
+            std::string_view data{m_buffer};
+
+            if(m_pos < data.size()) {
+                if(size_t next = impl::next_frame(data, m_pos); next) {
+                    msg = data.substr(m_pos, next - m_pos);
+                    m_offset += next - m_pos;
+                    m_pos = next;
+                    return true;
+                }
+            }
+
+            if(m_eof)
+                return false;
+            if(m_buffer.size() - m_pos > m_maxmessage)
+                impl::msgpack_except(
+                    "StreamFrameReader::next(): Message too large or malformed");
+
+            this->fill();
+        }
+    }
+
+    // Stream offset of the next message
+    [[nodiscard]] inline uint64_t offset() const { return m_offset; }
+    [[nodiscard]] inline size_t pending() const { return m_buffer.size() - m_pos; }
+
+private:
+    // Drops the consumed messages, then appends one chunk
+    void fill() {
+        m_buffer.erase(0, m_pos);
+        m_pos = 0;
+
+        const size_t n = m_buffer.size();
+        m_buffer.resize(n + m_chunk);
+
+        ssize_t r;
+        do {
+            r = ::read(m_fd, m_buffer.data() + n, m_chunk);
+        } while(r == -1 && errno == EINTR);
+
+        if(r == -1) {
+            m_buffer.resize(n);
+            impl::msgpack_except("StreamFrameReader::next(): Read error");
+        }
+
+        m_buffer.resize(n + static_cast<size_t>(r));
+        m_eof = r == 0;
+    }
+
+    int m_fd;
+    size_t m_chunk;
+    size_t m_maxmessage;
+    std::string m_buffer;
+    size_t m_pos{0};
+    uint64_t m_offset{0};
+    bool m_eof{false};
+};
+
+// Callback 'f(msg, offset)' for every message of 'data' from 'nthreads'
+// threads (0: one per hardware thread), 'f' has to be thread safe. The split
+// is by bytes, moved to the next indexed boundary: messages appended after
+// the index was updated go to the last thread. Rethrows the first exception
+// of a worker, returns the messages visited
+template<typename Function>
+uint64_t parallel_for_each(std::string_view data, const FrameIndex& index,
+                           Function&& f, size_t nthreads = 0) {
+    const std::vector<uint64_t>& offsets = index.offsets();
+
+    if(!nthreads)
+        nthreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    nthreads = std::min(nthreads, std::max<size_t>(offsets.size(), 1));
+
+    std::vector<uint64_t> bounds{0};
+    for(size_t t = 1; t < nthreads; ++t) {
+        auto it = std::lower_bound(offsets.begin(), offsets.end(),
+                                   index.indexed_size() * t / nthreads);
+        uint64_t b = it != offsets.end() ? *it : index.indexed_size();
+        if(b > bounds.back())
+            bounds.push_back(b);
+    }
+    bounds.push_back(data.size());
+
+    const size_t nranges = bounds.size() - 1;
+    std::vector<uint64_t> counts(nranges, 0);
+    std::vector<std::exception_ptr> errors(nranges);
+    std::vector<std::thread> workers;
+    workers.reserve(nranges);
+
+    for(size_t t = 0; t < nranges; ++t) {
+        workers.emplace_back([&, t]() {
+            try {
+                FrameReader r{data.substr(0, bounds[t + 1]), bounds[t]};
+                counts[t] = r.for_each(f);
+            }
+            catch(...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+
+    for(std::thread& w : workers)
+        w.join();
+
+    uint64_t n = 0;
+    for(size_t t = 0; t < nranges; ++t) {
+        if(errors[t])
+            std::rethrow_exception(errors[t]);
+        n += counts[t];
+    }
+
+    return n;
+}
+
+} // namespace msgpack
+
+#if defined(MSGPACK_NAMESPACE)
+} // namespace MSGPACK_NAMESPACE
+#endif
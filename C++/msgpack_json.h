@@ -0,0 +1,333 @@
+#pragma once
+
+// Streaming MsgPack <-> JSON transcoding on top of RapidJSON, no DOM is built
+// in either direction: msgpack::visit() drives a rapidjson Writer, and the
+// rapidjson Reader drives a MsgPack packer through SAX events
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include <rapidjson/error/en.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include "msgpack.h"
+
+#if defined(MSGPACK_NAMESPACE)
+namespace MSGPACK_NAMESPACE {
+#endif
+
+namespace msgpack {
+
+namespace impl {
+
+inline constexpr std::string_view BASE64_CHARS =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Padded base64, JSON has no byte strings
+template<typename T>
+std::string base64(Span<const T> data) {
+    const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+    const size_t n = data.size();
+    std::string s;
+    s.reserve(((n + 2) / 3) * 4);
+
+    size_t i = 0;
+    for(; i + 3 <= n; i += 3) {
+        uint32_t v = (uint32_t{p[i]} << 16) | (uint32_t{p[i + 1]} << 8) | p[i + 2];
+        s += BASE64_CHARS[(v >> 18) & 0x3F];
+        s += BASE64_CHARS[(v >> 12) & 0x3F];
+        s += BASE64_CHARS[(v >> 6) & 0x3F];
+        s += BASE64_CHARS[v & 0x3F];
+    }
+
+    if(i < n) {
+        uint32_t v = uint32_t{p[i]} << 16;
+        if(i + 1 < n)
+            v |= uint32_t{p[i + 1]} << 8;
+
+        s += BASE64_CHARS[(v >> 18) & 0x3F];
+        s += BASE64_CHARS[(v >> 12) & 0x3F];
+        s += i + 1 < n ? BASE64_CHARS[(v >> 6) & 0x3F] : '=';
+        s += '=';
+    }
+
+    return s;
+}
+
+} // namespace impl
+
+// Visitor writing JSON events to a rapidjson Writer (or PrettyWriter). Bin
+// and ext payloads are written as base64 strings, timestamps as seconds since
+// the epoch. Map keys have to be strings, integers, bins or exts
+template<typename Writer, typename Container = std::string>
+class JsonVisitor: public BasicVisitor<Container> {
+public:
+    using IntegerType = typename BasicVisitor<Container>::IntegerType;
+    using BinType = typename BasicVisitor<Container>::BinType;
+
+    explicit JsonVisitor(Writer& w): m_writer{w} {}
+
+    bool start_map(size_t /* size */) {
+        return this->check_value() && m_writer.StartObject();
+    }
+    bool end_map() { return m_writer.EndObject(); }
+    bool start_map_key(size_t /* index */) {
+        m_key = true;
+        return true;
+    }
+    bool end_map_key(size_t /* index */) {
+        m_key = false;
+        return true;
+    }
+    bool start_array(size_t /* size */) {
+        return this->check_value() && m_writer.StartArray();
+    }
+    bool end_array() { return m_writer.EndArray(); }
+
+    bool visit_nil() { return this->check_value() && m_writer.Null(); }
+    bool visit_bool(bool arg) { return this->check_value() && m_writer.Bool(arg); }
+    bool visit_float(float arg) { return this->visit_double(arg); }
+    bool visit_double(double arg) {
+        return this->check_value() && m_writer.Double(arg);
+    }
+
+    bool visit_str(std::string_view arg) {
+        auto n = static_cast<rapidjson::SizeType>(arg.size());
+        return m_key ? m_writer.Key(arg.data(), n, true)
+                     : m_writer.String(arg.data(), n, true);
+    }
+
+    bool visit_int(IntegerType arg) {
+        return std::visit(
+            [&](auto v) {
+                if(m_key) {
+                    char buf[24];
+                    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+                    return m_writer.Key(buf, static_cast<rapidjson::SizeType>(r.ptr - buf),
+                                        true);
+                }
+
+                if constexpr(std::is_signed_v<decltype(v)>)
+                    return m_writer.Int64(v);
+                else
+                    return m_writer.Uint64(v);
+            },
+            arg);
+    }
+
+    bool visit_timestamp(Timestamp arg) {
+        return this->visit_double(static_cast<double>(arg.seconds) +
+                                  static_cast<double>(arg.nanoseconds) / 1e9);
+    }
+
+    bool visit_bin(BinType arg) { return this->visit_str(impl::base64(arg)); }
+    bool visit_ext(int8_t /*type*/, BinType arg) { return this->visit_bin(arg); }
+
+private:
+    inline bool check_value() const {
+        if(m_key)
+            impl::msgpack_except("msgpack::to_json(): Unsupported map key");
+        return true;
+    }
+
+    Writer& m_writer;
+    bool m_key{false};
+};
+
+// SAX handler for rapidjson::Reader packing each event as it arrives. Map
+// and array counts are only known at their end: a 5 byte header is reserved
+// and patched with the smallest encoding. The unused header bytes are all
+// squeezed out in one pass once the outermost container closes, so every
+// byte moves once whatever the nesting, and the output matches what pack()
+// writes for the same document
+template<typename MsgPackType = MsgPack>
+class JsonHandler {
+public:
+    using ContainerType = typename MsgPackType::ContainerType;
+
+    explicit JsonHandler(ContainerType& c): m_mp{c} {}
+
+    bool Null() {
+        m_mp.pack(nullptr);
+        return true;
+    }
+    bool Bool(bool b) {
+        m_mp.pack(b);
+        return true;
+    }
+    bool Int(int i) {
+        m_mp.pack(i);
+        return true;
+    }
+    bool Uint(unsigned i) {
+        m_mp.pack(i);
+        return true;
+    }
+    bool Int64(int64_t i) {
+        m_mp.pack(i);
+        return true;
+    }
+    bool Uint64(uint64_t i) {
+        m_mp.pack(i);
+        return true;
+    }
+    bool Double(double d) {
+        m_mp.pack(d);
+        return true;
+    }
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool copy) {
+        return this->String(str, length, copy);
+    }
+    bool String(const char* str, rapidjson::SizeType length, bool /* copy */) {
+        m_mp.pack(std::string_view{str, length});
+        return true;
+    }
+    bool Key(const char* str, rapidjson::SizeType length, bool copy) {
+        return this->String(str, length, copy);
+    }
+
+    bool StartObject() { return this->open(); }
+    bool EndObject(rapidjson::SizeType n) {
+        return this->close(n, {impl::Format::FIXMAP, impl::Format::MAP16,
+                               impl::Format::MAP32});
+    }
+    bool StartArray() { return this->open(); }
+    bool EndArray(rapidjson::SizeType n) {
+        return this->close(n, {impl::Format::FIXARRAY, impl::Format::ARRAY16,
+                               impl::Format::ARRAY32});
+    }
+
+private:
+    static constexpr size_t RESERVED = 5;
+
+    struct Header {
+        size_t at;   // Offset of the reserved bytes
+        size_t size; // Bytes in use, known at close
+    };
+
+    bool open() {
+        if(m_open.size() >= MSGPACK_MAX_DEPTH)
+            return false;
+
+        ContainerType& c = m_mp.buffer.get();
+        m_open.push_back(m_headers.size());
+        m_headers.push_back({c.size(), RESERVED});
+        c.resize(c.size() + RESERVED);
+        return true;
+    }
+
+    bool close(uint32_t n, const std::array<uint8_t, 3>& formats) {
+        ContainerType& c = m_mp.buffer.get();
+        Header& header = m_headers[m_open.back()];
+        m_open.pop_back();
+
+        auto* h = reinterpret_cast<uint8_t*>(c.data() + header.at);
+        size_t size = 1;
+
+        if(n <= 0xF)
+            h[0] = formats[0] | static_cast<uint8_t>(n);
+        else if(n <= std::numeric_limits<uint16_t>::max()) {
+            h[0] = formats[1];
+            impl::store_bigendian(h + 1, static_cast<uint16_t>(n));
+            size = 3;
+        }
+        else {
+            h[0] = formats[2];
+            impl::store_bigendian(h + 1, n);
+            size = 5;
+        }
+
+        header.size = size;
+        if(m_open.empty())
+            this->compact();
+
+        return true;
+    }
+
+    // Headers are in offset order: slide everything in between down over the
+    // unused bytes of the previous ones
+    void compact() {
+        ContainerType& c = m_mp.buffer.get();
+        auto* p = reinterpret_cast<uint8_t*>(c.data());
+        size_t in = m_headers.front().at, out = in;
+
+        for(const Header& h : m_headers) {
+            std::memmove(p + out, p + in, h.at + h.size - in);
+            out += h.at + h.size - in;
+            in = h.at + RESERVED;
+        }
+
+        std::memmove(p + out, p + in, c.size() - in);
+        c.resize(out + c.size() - in);
+        m_headers.clear();
+    }
+
+    MsgPackType m_mp;
+    std::vector<Header> m_headers; // Every container of the document
+    std::vector<size_t> m_open;    // Indices in m_headers of the open ones
+};
+
+// First message in 'c' as JSON events to 'w', false when the writer rejects
+// one of them (e.g. NaN with the default flags)
+template<typename Writer, typename MsgPackType = MsgPack>
+bool to_json(const typename MsgPackType::ContainerType& c, Writer& w) {
+    MsgPackType mp{c};
+    JsonVisitor<Writer, typename MsgPackType::ContainerType> v{w};
+    return impl::visit(mp, v, MSGPACK_MAX_DEPTH) && w.IsComplete();
+}
+
+template<typename MsgPackType = MsgPack>
+std::string to_json(const typename MsgPackType::ContainerType& c) {
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> w{sb};
+
+    if(!msgpack::to_json<rapidjson::Writer<rapidjson::StringBuffer>, MsgPackType>(c, w))
+        impl::msgpack_except("msgpack::to_json(): Not representable as JSON");
+
+    return {sb.GetString(), sb.GetSize()};
+}
+
+// Appends the JSON document in 'json' to 'c' as one message, 'c' is left as
+// it was when it throws. The reader runs iteratively, nesting is bounded by
+// MSGPACK_MAX_DEPTH
+template<typename MsgPackType = MsgPack>
+void from_json(std::string_view json, typename MsgPackType::ContainerType& c) {
+    constexpr unsigned FLAGS = rapidjson::kParseIterativeFlag;
+
+    const size_t size = c.size();
+    JsonHandler<MsgPackType> h{c};
+    rapidjson::MemoryStream ms{json.data(), json.size()};
+    rapidjson::Reader reader;
+
+    rapidjson::ParseResult r = reader.Parse<FLAGS>(ms, h);
+    if(r.IsError()) {
+        c.resize(size); // Partial message, reserved headers unpatched
+
+        std::string err = "msgpack::from_json(): ";
+        err += rapidjson::GetParseError_En(r.Code());
+        err += " (offset " + std::to_string(r.Offset()) + ")";
+        impl::msgpack_except(err.c_str());
+    }
+}
+
+template<typename MsgPackType = MsgPack>
+typename MsgPackType::ContainerType from_json(std::string_view json) {
+    typename MsgPackType::ContainerType c;
+    msgpack::from_json<MsgPackType>(json, c);
+    return c;
+}
+
+} // namespace msgpack
+
+#if defined(MSGPACK_NAMESPACE)
+} // namespace MSGPACK_NAMESPACE
+#endif